@@ -0,0 +1,1271 @@
+//
+// Microbenchmarks for ThreadPool, IPCManager and ProcessManager.
+//
+// Every result is printed to stdout as one JSON object per line so runs can
+// be appended to a file and compared over time; progress goes to stderr.
+//
+//   make bench [BENCH_ARGS="..."]     (writes bench_results.jsonl)
+//   ./bench_runner [--quick] [--filter <substring>]
+//
+//   --quick    ~10x fewer iterations, for smoke runs
+//   --filter   only run benchmarks whose name contains the substring
+//
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "event_loop.h"
+#include "fifo_channel.h"
+#include "frame_reader.h"
+#include "io_ring.h"
+#include "ipc_manager.h"
+#include "latency_histogram.h"
+#include "process_manager.h"
+#include "process_pool.h"
+#include "shared_segment.h"
+#include "shm_snapshot.h"
+#include "thread_pool.h"
+
+using Clock = std::chrono::steady_clock;
+
+static size_t scale = 1;            // iteration divisor, 10 with --quick
+static std::string filter;
+
+static uint64_t nanosSince(Clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+static double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static bool selected(const std::string& name) {
+    return filter.empty() || name.find(filter) != std::string::npos;
+}
+
+static const char* modeName(SchedulingMode mode) {
+    switch (mode) {
+        case SchedulingMode::SHARED_QUEUE: return "SHARED_QUEUE";
+        case SchedulingMode::WORK_STEALING: return "WORK_STEALING";
+        case SchedulingMode::LOCK_FREE_RING: return "LOCK_FREE_RING";
+    }
+    return "?";
+}
+
+// Busy-wait for roughly 'ns' nanoseconds to simulate a task of that size.
+static void spinFor(uint64_t ns) {
+    if (ns == 0) {
+        return;
+    }
+    auto start = Clock::now();
+    while (nanosSince(start) < ns) {
+    }
+}
+
+// Wait for a flag in shared memory to change, without hogging a CPU the
+// peer may need.
+static uint32_t waitForChange(const std::atomic<uint32_t>& flag, uint32_t old) {
+    uint32_t v;
+    int spins = 0;
+    while ((v = flag.load(std::memory_order_acquire)) == old) {
+        if (++spins > 100) {
+            sched_yield();
+        }
+    }
+    return v;
+}
+
+static bool readExactly(int fd, char* buf, size_t n) {
+    size_t got = 0;
+    while (got < n) {
+        ssize_t r = read(fd, buf + got, n - got);
+        if (r <= 0) {
+            return false;
+        }
+        got += r;
+    }
+    return true;
+}
+
+/*
+ * Result:
+ * One output line. Parameters keep their insertion order.
+ */
+class Result {
+public:
+    explicit Result(const std::string& name) {
+        out << "{\"bench\":\"" << name << "\"";
+    }
+
+    Result& param(const std::string& key, const std::string& value) {
+        out << ",\"" << key << "\":\"" << value << "\"";
+        return *this;
+    }
+
+    Result& param(const std::string& key, uint64_t value) {
+        out << ",\"" << key << "\":" << value;
+        return *this;
+    }
+
+    Result& param(const std::string& key, double value) {
+        out << ",\"" << key << "\":" << std::fixed << value << std::defaultfloat;
+        return *this;
+    }
+
+    Result& rate(uint64_t ops, double seconds) {
+        param("ops", ops);
+        param("seconds", seconds);
+        return param("ops_per_sec", seconds > 0 ? ops / seconds : 0.0);
+    }
+
+    Result& latency(const LatencyHistogram& h, const std::string& prefix = "") {
+        param(prefix + "p50_ns", h.percentile(0.50));
+        param(prefix + "p90_ns", h.percentile(0.90));
+        param(prefix + "p99_ns", h.percentile(0.99));
+        param(prefix + "p999_ns", h.percentile(0.999));
+        param(prefix + "max_ns", h.max());
+        return param(prefix + "mean_ns", h.mean());
+    }
+
+    void print() {
+        out << "}";
+        std::cout << out.str() << std::endl;
+    }
+
+private:
+    std::ostringstream out;
+};
+
+// ------------------------------------------------------------
+// ThreadPool
+// ------------------------------------------------------------
+
+// Post N independent tasks from one external thread and wait for all of
+// them. Queue wait percentiles come from the pool's own metrics.
+static void benchPoolThroughput(SchedulingMode mode, size_t threads, uint64_t workNs) {
+    size_t tasks = (workNs == 0 ? 200000 : 20000) / scale;
+
+    ThreadPoolConfig cfg;
+    cfg.mode = mode;
+    cfg.numThreads = threads;
+    cfg.collectMetrics = true;
+    ThreadPool pool(cfg);
+
+    std::atomic<size_t> done(0);
+    auto start = Clock::now();
+    for (size_t i = 0; i < tasks; ++i) {
+        pool.post([&done, workNs] {
+            spinFor(workNs);
+            done.fetch_add(1, std::memory_order_relaxed);
+        });
+    }
+    while (done.load(std::memory_order_relaxed) < tasks) {
+        sched_yield();
+    }
+    double seconds = secondsSince(start);
+
+    ThreadPoolStats stats = pool.stats();
+    Result("threadpool_throughput")
+        .param("mode", modeName(mode))
+        .param("threads", static_cast<uint64_t>(threads))
+        .param("work_ns", workNs)
+        .rate(tasks, seconds)
+        .latency(stats.queueWait, "queue_wait_")
+        .param("steals", stats.steals)
+        .print();
+}
+
+// Sequential submit() + get() round trips: the wakeup latency of an idle pool.
+static void benchPoolLatency(SchedulingMode mode, size_t threads) {
+    size_t rounds = 20000 / scale;
+    ThreadPool pool(threads, mode);
+    LatencyHistogram hist;
+
+    auto start = Clock::now();
+    for (size_t i = 0; i < rounds; ++i) {
+        auto t0 = Clock::now();
+        pool.submit([] { return 1; }).get();
+        hist.record(nanosSince(t0));
+    }
+    double seconds = secondsSince(start);
+
+    Result("threadpool_submit_latency")
+        .param("mode", modeName(mode))
+        .param("threads", static_cast<uint64_t>(threads))
+        .rate(rounds, seconds)
+        .latency(hist)
+        .print();
+}
+
+// ------------------------------------------------------------
+// IPC
+// ------------------------------------------------------------
+
+// Parent -> child -> parent over two unnamed pipes.
+static void benchPipeRoundTrip(size_t msgSize) {
+    size_t rounds = 20000 / scale;
+    Pipe toChild, toParent;
+    if (!IPCManager::createPipe(toChild) || !IPCManager::createPipe(toParent)) {
+        return;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork failed");
+        return;
+    }
+    if (pid == 0) {
+        close(toChild.writeFd);
+        close(toParent.readFd);
+        std::vector<char> buf(msgSize);
+        while (readExactly(toChild.readFd, buf.data(), msgSize)) {
+            if (write(toParent.writeFd, buf.data(), msgSize) != static_cast<ssize_t>(msgSize)) {
+                break;
+            }
+        }
+        _exit(0);
+    }
+    close(toChild.readFd);
+    close(toParent.writeFd);
+
+    std::string msg(msgSize, 'x');
+    std::vector<char> reply(msgSize);
+    LatencyHistogram hist;
+    auto start = Clock::now();
+    for (size_t i = 0; i < rounds; ++i) {
+        auto t0 = Clock::now();
+        if (!IPCManager::writeToPipe(toChild, msg) || !readExactly(toParent.readFd, reply.data(), msgSize)) {
+            break;
+        }
+        hist.record(nanosSince(t0));
+    }
+    double seconds = secondsSince(start);
+
+    close(toChild.writeFd);
+    close(toParent.readFd);
+    waitpid(pid, nullptr, 0);
+
+    Result("pipe_round_trip")
+        .param("msg_bytes", static_cast<uint64_t>(msgSize))
+        .rate(hist.count(), seconds)
+        .latency(hist)
+        .print();
+}
+
+// One-way bulk transfer; the child drains and discards.
+static void benchPipeBandwidth(size_t chunk) {
+    size_t total = (size_t(256) << 20) / scale;
+    Pipe p;
+    if (!IPCManager::createPipe(p)) {
+        return;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork failed");
+        return;
+    }
+    if (pid == 0) {
+        close(p.writeFd);
+        std::vector<char> buf(chunk);
+        while (read(p.readFd, buf.data(), chunk) > 0) {
+        }
+        _exit(0);
+    }
+    close(p.readFd);
+
+    std::string block(chunk, 'x');
+    auto start = Clock::now();
+    size_t sent = 0;
+    while (sent < total && IPCManager::writeToPipe(p, block)) {
+        sent += chunk;
+    }
+    close(p.writeFd);
+    waitpid(pid, nullptr, 0);
+    double seconds = secondsSince(start);
+
+    Result("pipe_bandwidth")
+        .param("chunk_bytes", static_cast<uint64_t>(chunk))
+        .param("bytes", static_cast<uint64_t>(sent))
+        .param("bytes_per_sec", seconds > 0 ? sent / seconds : 0.0)
+        .rate(sent / chunk, seconds)
+        .print();
+}
+
+// Same transfer with sendPages() on the parent side and splice() into
+// /dev/null on the child side, so no payload byte is copied in user space.
+static void benchPipeSpliceBandwidth(size_t chunk) {
+    size_t total = (size_t(256) << 20) / scale;
+    Pipe p;
+    if (!IPCManager::createPipe(p)) {
+        return;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork failed");
+        return;
+    }
+    if (pid == 0) {
+        close(p.writeFd);
+        int sink = open("/dev/null", O_WRONLY);
+        IPCManager::transfer(p.readFd, sink);
+        _exit(0);
+    }
+    close(p.readFd);
+
+    // Never modified after the first send, as sendPages() requires.
+    std::string block(chunk, 'x');
+    auto start = Clock::now();
+    size_t sent = 0;
+    while (sent < total && IPCManager::sendPages(p, block.data(), chunk)) {
+        sent += chunk;
+    }
+    close(p.writeFd);
+    waitpid(pid, nullptr, 0);
+    double seconds = secondsSince(start);
+
+    Result("pipe_splice_bandwidth")
+        .param("chunk_bytes", static_cast<uint64_t>(chunk))
+        .param("bytes", static_cast<uint64_t>(sent))
+        .param("bytes_per_sec", seconds > 0 ? sent / seconds : 0.0)
+        .rate(sent / chunk, seconds)
+        .print();
+}
+
+// One-way stream of small framed messages, so this measures per-message
+// cost rather than bandwidth. With batch > 1 the child sends them with
+// sendFrames() and the parent drains each read() in one go.
+static void benchPipeFramed(size_t msgSize, size_t batch) {
+    size_t count = 1000000 / scale;
+    Pipe p;
+    if (!IPCManager::createPipe(p)) {
+        return;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork failed");
+        return;
+    }
+    if (pid == 0) {
+        close(p.readFd);
+        std::vector<std::string> msgs(batch, std::string(msgSize, 'x'));
+        for (size_t sent = 0; sent < count; sent += batch) {
+            bool ok = batch == 1 ? IPCManager::sendFrame(p, msgs[0]) : IPCManager::sendFrames(p, msgs);
+            if (!ok) {
+                break;
+            }
+        }
+        _exit(0);
+    }
+    close(p.writeFd);
+
+    FrameReader reader(p.readFd);
+    uint64_t received = 0;
+    uint64_t reads = 0;
+    auto start = Clock::now();
+    if (batch == 1) {
+        const char* data;
+        size_t length;
+        while (reader.next(data, length) == FrameReader::Status::OK) {
+            ++received;
+        }
+    } else {
+        while (reader.drain([&received](const char*, size_t) { ++received; }) == FrameReader::Status::OK) {
+            ++reads;
+        }
+    }
+    double seconds = secondsSince(start);
+    close(p.readFd);
+    waitpid(pid, nullptr, 0);
+
+    Result("pipe_framed")
+        .param("msg_bytes", static_cast<uint64_t>(msgSize))
+        .param("batch", static_cast<uint64_t>(batch))
+        .param("msgs_per_drain", reads ? static_cast<double>(received) / reads : 0.0)
+        .rate(received, seconds)
+        .print();
+}
+
+// Child side of the IoRing benchmarks: drains 'fd' and checks that the
+// sequence numbers leading each 'msgSize'-byte message count up from 0.
+static bool readInSequence(int fd, size_t msgSize) {
+    std::vector<char> buf(1 << 16);
+    size_t have = 0;
+    uint64_t expect = 0;
+    bool inOrder = true;
+    ssize_t n;
+    while ((n = read(fd, buf.data() + have, buf.size() - have)) > 0) {
+        have += static_cast<size_t>(n);
+        size_t used = 0;
+        for (; have - used >= msgSize; used += msgSize) {
+            uint64_t seq;
+            memcpy(&seq, buf.data() + used, sizeof(seq));
+            inOrder = inOrder && seq == expect;
+            ++expect;
+        }
+        memmove(buf.data(), buf.data() + used, have - used);
+        have -= used;
+    }
+    return inOrder;
+}
+
+// Small unframed writes into a pipe: one write() per message against
+// IoRing batches of 'batch' writes per submission, 'linked' into one
+// ordered run or not. Every message starts with its sequence number and
+// the child checks they arrive in order.
+static void benchPipeIoRing(size_t msgSize, size_t batch, bool linked) {
+    size_t count = 1000000 / scale;
+    if (msgSize < sizeof(uint64_t)) {
+        msgSize = sizeof(uint64_t);
+    }
+    Pipe p;
+    if (!IPCManager::createPipe(p)) {
+        return;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork failed");
+        return;
+    }
+    if (pid == 0) {
+        close(p.writeFd);
+        _exit(readInSequence(p.readFd, msgSize) ? 0 : 1);
+    }
+    close(p.readFd);
+
+    // One buffer per operation in flight, stamped before it is queued
+    std::vector<std::string> msgs(batch, std::string(msgSize, 'x'));
+    IoRing ring(static_cast<unsigned>(batch), linked);
+    size_t sent = 0;
+    auto start = Clock::now();
+    if (batch == 1) {
+        while (sent < count) {
+            uint64_t seq = sent;
+            memcpy(&msgs[0][0], &seq, sizeof(seq));
+            if (write(p.writeFd, msgs[0].data(), msgSize) != static_cast<ssize_t>(msgSize)) {
+                break;
+            }
+            ++sent;
+        }
+    } else {
+        bool ok = true;
+        while (ok && sent < count) {
+            size_t n = count - sent < batch ? count - sent : batch;
+            for (size_t i = 0; i < n; ++i) {
+                uint64_t seq = sent + i;
+                memcpy(&msgs[i][0], &seq, sizeof(seq));
+                ring.prepWrite(p.writeFd, msgs[i].data(), static_cast<unsigned>(msgSize), i);
+            }
+            ok = ring.submitAndWait(static_cast<unsigned>(n));
+            size_t written = 0;
+            ring.reap([&](const IoRing::Completion& c) {
+                if (c.result == static_cast<int>(msgSize)) {
+                    ++written;
+                } else {
+                    ok = false;
+                }
+            });
+            sent += written;
+        }
+    }
+    double seconds = secondsSince(start);
+    close(p.writeFd);
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    Result("pipe_io_ring")
+        .param("backend", batch == 1 ? "write" : (ring.usingUring() ? "io_uring" : "fallback"))
+        .param("msg_bytes", static_cast<uint64_t>(msgSize))
+        .param("batch", static_cast<uint64_t>(batch))
+        .param("linked", linked ? "yes" : "no")
+        .param("in_order", WIFEXITED(status) && WEXITSTATUS(status) == 0 ? "yes" : "no")
+        .rate(sent, seconds)
+        .print();
+}
+
+// The linked IoRing writes again, driven by an EventLoop the way a
+// server would: completions arrive through IoRing::attach() and the
+// next batch is queued once the previous one has been reaped.
+static void benchPipeIoRingLoop(size_t msgSize, size_t batch) {
+    size_t count = 1000000 / scale;
+    if (msgSize < sizeof(uint64_t)) {
+        msgSize = sizeof(uint64_t);
+    }
+    Pipe p;
+    if (!IPCManager::createPipe(p)) {
+        return;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork failed");
+        return;
+    }
+    if (pid == 0) {
+        close(p.writeFd);
+        _exit(readInSequence(p.readFd, msgSize) ? 0 : 1);
+    }
+    close(p.readFd);
+
+    std::vector<std::string> msgs(batch, std::string(msgSize, 'x'));
+    IoRing ring(static_cast<unsigned>(batch), true);
+    EventLoop loop;
+    size_t queuedUpTo = 0;
+    size_t sent = 0;
+    bool ok = true;
+
+    auto queueBatch = [&]() {
+        size_t n = count - queuedUpTo < batch ? count - queuedUpTo : batch;
+        for (size_t i = 0; i < n; ++i) {
+            uint64_t seq = queuedUpTo + i;
+            memcpy(&msgs[i][0], &seq, sizeof(seq));
+            ring.prepWrite(p.writeFd, msgs[i].data(), static_cast<unsigned>(msgSize), i);
+        }
+        queuedUpTo += n;
+        ok = ring.submit() != -1;
+    };
+    bool attached = ring.attach(loop, [&](const IoRing::Completion& c) {
+        if (c.result == static_cast<int>(msgSize)) {
+            ++sent;
+        } else {
+            ok = false;
+        }
+    });
+
+    auto start = Clock::now();
+    if (attached) {
+        queueBatch();
+        while (ok && sent < count && loop.runOnce(-1) != -1) {
+            if (ring.inFlight() == 0 && queuedUpTo < count) {
+                queueBatch();
+            }
+        }
+    }
+    double seconds = secondsSince(start);
+    ring.detach();
+    close(p.writeFd);
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    Result("pipe_io_ring_loop")
+        .param("backend", ring.usingUring() ? "io_uring" : "fallback")
+        .param("msg_bytes", static_cast<uint64_t>(msgSize))
+        .param("batch", static_cast<uint64_t>(batch))
+        .param("in_order", WIFEXITED(status) && WEXITSTATUS(status) == 0 ? "yes" : "no")
+        .rate(sent, seconds)
+        .print();
+}
+
+// Round trip through two FIFOs using the path-based IPCManager calls,
+// which open and close the FIFO on every message.
+static void benchFifoRoundTrip() {
+    size_t rounds = 2000 / scale;
+    std::string ping = "/tmp/ptm_bench_ping_" + std::to_string(getpid());
+    std::string pong = "/tmp/ptm_bench_pong_" + std::to_string(getpid());
+    if (!IPCManager::createFIFO(ping) || !IPCManager::createFIFO(pong)) {
+        return;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork failed");
+        unlink(ping.c_str());
+        unlink(pong.c_str());
+        return;
+    }
+    if (pid == 0) {
+        while (true) {
+            std::string msg = IPCManager::readFromFIFO(ping, 64);
+            if (msg.empty() || msg == "quit") {
+                break;
+            }
+            IPCManager::writeToFIFO(pong, msg);
+        }
+        _exit(0);
+    }
+
+    LatencyHistogram hist;
+    auto start = Clock::now();
+    for (size_t i = 0; i < rounds; ++i) {
+        auto t0 = Clock::now();
+        if (!IPCManager::writeToFIFO(ping, "ping") || IPCManager::readFromFIFO(pong, 64).empty()) {
+            break;
+        }
+        hist.record(nanosSince(t0));
+    }
+    double seconds = secondsSince(start);
+
+    IPCManager::writeToFIFO(ping, "quit");
+    waitpid(pid, nullptr, 0);
+    unlink(ping.c_str());
+    unlink(pong.c_str());
+
+    Result("fifo_round_trip")
+        .rate(hist.count(), seconds)
+        .latency(hist)
+        .print();
+}
+
+// Same round trip as above over FifoChannels that stay open, to compare
+// against the per-message open/close.
+static void benchFifoChannelRoundTrip() {
+    size_t rounds = 20000 / scale;
+    std::string ping = "/tmp/ptm_bench_ping_" + std::to_string(getpid());
+    std::string pong = "/tmp/ptm_bench_pong_" + std::to_string(getpid());
+    if (!IPCManager::createFIFO(ping) || !IPCManager::createFIFO(pong)) {
+        return;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork failed");
+        unlink(ping.c_str());
+        unlink(pong.c_str());
+        return;
+    }
+    if (pid == 0) {
+        FifoChannel in, out;
+        if (!in.open(ping, FifoChannel::Direction::READ)
+            || !out.open(pong, FifoChannel::Direction::WRITE)) {
+            _exit(1);
+        }
+        std::string msg;
+        while (in.receive(msg) == FrameReader::Status::OK && out.send(msg)) {
+        }
+        _exit(0);
+    }
+
+    FifoChannel out, in;
+    LatencyHistogram hist;
+    double seconds = 0;
+    if (out.open(ping, FifoChannel::Direction::WRITE) && in.open(pong, FifoChannel::Direction::READ)) {
+        std::string reply;
+        auto start = Clock::now();
+        for (size_t i = 0; i < rounds; ++i) {
+            auto t0 = Clock::now();
+            if (!out.send("ping") || in.receive(reply) != FrameReader::Status::OK) {
+                break;
+            }
+            hist.record(nanosSince(t0));
+        }
+        seconds = secondsSince(start);
+    }
+
+    out.close();
+    in.close();
+    waitpid(pid, nullptr, 0);
+    unlink(ping.c_str());
+    unlink(pong.c_str());
+
+    Result("fifo_channel_round_trip")
+        .rate(hist.count(), seconds)
+        .latency(hist)
+        .print();
+}
+
+// Control block at the start of the shared segment, data after it.
+struct ShmChannel {
+    alignas(64) std::atomic<uint32_t> ping;
+    alignas(64) std::atomic<uint32_t> pong;
+    alignas(64) size_t length;
+};
+
+// Maps a fresh segment of 'size' bytes; the name is unlinked right away
+// since both sides inherit the mapping through fork().
+static ShmChannel* mapBenchSegment(size_t size) {
+    std::string name = "/ptm_bench_" + std::to_string(getpid());
+    int fd = IPCManager::createSharedMemory(name, size);
+    if (fd == -1) {
+        return nullptr;
+    }
+    void* addr = IPCManager::mapSharedMemory(fd, size);
+    close(fd);
+    IPCManager::unlinkSharedMemory(name);
+    if (!addr) {
+        return nullptr;
+    }
+    ShmChannel* ch = new (addr) ShmChannel();
+    ch->ping.store(0, std::memory_order_relaxed);
+    ch->pong.store(0, std::memory_order_relaxed);
+    ch->length = 0;
+    return ch;
+}
+
+// Round trip over a shared segment: flip a counter, wait for the echo.
+static void benchShmRoundTrip() {
+    size_t rounds = 20000 / scale;
+    ShmChannel* ch = mapBenchSegment(sizeof(ShmChannel));
+    if (!ch) {
+        return;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork failed");
+        munmap(ch, sizeof(ShmChannel));
+        return;
+    }
+    if (pid == 0) {
+        uint32_t seq = 0;
+        while (true) {
+            seq = waitForChange(ch->ping, seq);
+            ch->pong.store(seq, std::memory_order_release);
+            if (seq == UINT32_MAX) {
+                break;
+            }
+        }
+        _exit(0);
+    }
+
+    LatencyHistogram hist;
+    auto start = Clock::now();
+    for (uint32_t i = 1; i <= rounds; ++i) {
+        auto t0 = Clock::now();
+        ch->ping.store(i, std::memory_order_release);
+        waitForChange(ch->pong, i - 1);
+        hist.record(nanosSince(t0));
+    }
+    double seconds = secondsSince(start);
+
+    ch->ping.store(UINT32_MAX, std::memory_order_release);
+    waitpid(pid, nullptr, 0);
+    munmap(ch, sizeof(ShmChannel));
+
+    Result("shm_round_trip")
+        .rate(rounds, seconds)
+        .latency(hist)
+        .print();
+}
+
+// Producer copies a block in, consumer copies it out, one block in flight.
+static void benchShmBandwidth(size_t chunk) {
+    size_t total = (size_t(1) << 30) / scale;
+    size_t segment = sizeof(ShmChannel) + chunk;
+    ShmChannel* ch = mapBenchSegment(segment);
+    if (!ch) {
+        return;
+    }
+    char* data = reinterpret_cast<char*>(ch + 1);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork failed");
+        munmap(ch, segment);
+        return;
+    }
+    if (pid == 0) {
+        std::vector<char> sink(chunk);
+        uint32_t seq = 0;
+        while (true) {
+            seq = waitForChange(ch->ping, seq);
+            if (seq == UINT32_MAX) {
+                break;
+            }
+            memcpy(sink.data(), data, ch->length);
+            ch->pong.store(seq, std::memory_order_release);
+        }
+        _exit(0);
+    }
+
+    std::vector<char> block(chunk, 'x');
+    size_t blocks = total / chunk;
+    auto start = Clock::now();
+    for (uint32_t i = 1; i <= blocks; ++i) {
+        memcpy(data, block.data(), chunk);
+        ch->length = chunk;
+        ch->ping.store(i, std::memory_order_release);
+        waitForChange(ch->pong, i - 1);
+    }
+    double seconds = secondsSince(start);
+
+    ch->ping.store(UINT32_MAX, std::memory_order_release);
+    waitpid(pid, nullptr, 0);
+    munmap(ch, segment);
+
+    size_t bytes = blocks * chunk;
+    Result("shm_bandwidth")
+        .param("chunk_bytes", static_cast<uint64_t>(chunk))
+        .param("bytes", static_cast<uint64_t>(bytes))
+        .param("bytes_per_sec", seconds > 0 ? bytes / seconds : 0.0)
+        .rate(blocks, seconds)
+        .print();
+}
+
+// Setup time plus one write pass over a fresh segment: where the page
+// faults are paid depends on the prefault / huge page options.
+static void benchShmFirstTouch(const char* label, const SegmentOptions& options) {
+    size_t size = (size_t(512) << 20) / scale;
+    std::string name = "/ptm_bench_touch_" + std::to_string(getpid());
+
+    auto start = Clock::now();
+    SharedSegment seg;
+    if (!seg.create(name, size, options)) {
+        return;
+    }
+    double setup = secondsSince(start);
+
+    auto t0 = Clock::now();
+    char* data = seg.as<char>();
+    for (size_t off = 0; off < seg.size(); off += 64) {
+        data[off] = 1;
+    }
+    double pass = secondsSince(t0);
+
+    Result("shm_first_touch")
+        .param("options", label)
+        .param("bytes", static_cast<uint64_t>(seg.size()))
+        .param("huge_pages", static_cast<uint64_t>(seg.hugePages()))
+        .param("setup_seconds", setup)
+        .param("first_pass_seconds", pass)
+        .print();
+}
+
+// One writer republishing a value as fast as it can while readers take
+// snapshots. Every value is one repeated byte, so a torn read would show.
+static void benchShmSnapshot(size_t valueSize, size_t readers) {
+    auto duration = std::chrono::milliseconds(1000 / scale);
+    std::string name = "/ptm_bench_snap_" + std::to_string(getpid());
+    ShmSnapshot writer;
+    if (!writer.create(name, valueSize)) {
+        return;
+    }
+    writer.publish(std::string(valueSize, 0));
+
+    std::atomic<bool> done(false);
+    std::atomic<uint64_t> reads(0);
+    std::atomic<uint64_t> torn(0);
+    std::vector<std::thread> threads;
+    for (size_t r = 0; r < readers; ++r) {
+        threads.emplace_back([&]() {
+            ShmSnapshot reader;
+            if (!reader.open(name)) {
+                return;
+            }
+            std::string value;
+            uint64_t n = 0;
+            while (!done.load(std::memory_order_relaxed)) {
+                reader.read(value);
+                if (value.find_first_not_of(value[0]) != std::string::npos) {
+                    torn.fetch_add(1, std::memory_order_relaxed);
+                }
+                ++n;
+            }
+            reads.fetch_add(n, std::memory_order_relaxed);
+        });
+    }
+
+    std::string value(valueSize, 0);
+    uint64_t publishes = 0;
+    auto start = Clock::now();
+    while (Clock::now() - start < duration) {
+        char* buf = writer.beginWrite();
+        memset(buf, static_cast<int>(++publishes & 0xff), valueSize);
+        writer.commitWrite(valueSize);
+    }
+    done.store(true);
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    double seconds = secondsSince(start);
+
+    Result("shm_snapshot")
+        .param("value_bytes", static_cast<uint64_t>(valueSize))
+        .param("readers", static_cast<uint64_t>(readers))
+        .param("publishes_per_sec", seconds > 0 ? publishes / seconds : 0.0)
+        .param("torn_reads", torn.load())
+        .rate(reads.load(), seconds)
+        .print();
+}
+
+// ------------------------------------------------------------
+// ProcessManager
+// ------------------------------------------------------------
+
+// createProcess() latency alone, and spawn-to-reaped for /bin/true.
+// Table operations for a supervisor tracking 'entries' children; no real
+// processes, the pids are made up.
+static void benchProcessTable(size_t entries) {
+    size_t rounds = 20 / (scale > 10 ? 10 : scale);
+    ProcessTable table;
+    LatencyHistogram scanHist;
+    size_t ops = 0;
+    uint64_t visited = 0;
+
+    auto start = Clock::now();
+    for (size_t r = 0; r < rounds; ++r) {
+        pid_t base = static_cast<pid_t>(r * entries + 1);
+        for (size_t i = 0; i < entries; ++i) {
+            table.insert(base + static_cast<pid_t>(i), "worker");
+        }
+        for (size_t i = 0; i < entries; ++i) {
+            table.setState(base + static_cast<pid_t>(i), ProcessState::STOPPED);
+        }
+        auto t0 = Clock::now();
+        table.forEach([&visited](const ProcessInfo& info) { visited += info.pid != 0; });
+        scanHist.record(nanosSince(t0));
+        for (size_t i = 0; i < entries; ++i) {
+            table.markExited(base + static_cast<pid_t>(i), 0);
+        }
+        ops += 3 * entries;
+    }
+    double seconds = secondsSince(start);
+
+    Result("process_table")
+        .param("entries", static_cast<uint64_t>(entries))
+        .param("visited", visited)
+        .rate(ops, seconds)
+        .latency(scanHist, "scan_")
+        .print();
+}
+
+// One ProcessManager::sampleNow() pass over 'children' idle children. The
+// first pass opens the /proc files; later ones only pread() them.
+static void benchSampler() {
+    size_t children = 1000 / scale;
+    ProcessManager pm;
+    std::vector<pid_t> pids;
+    for (size_t i = 0; i < children; ++i) {
+        pid_t pid = pm.createProcess({"sleep", "60"});
+        if (pid > 0) {
+            pids.push_back(pid);
+        }
+    }
+    usleep(100 * 1000);     // let them exec
+
+    auto start = Clock::now();
+    pm.sampleNow();
+    double firstSeconds = secondsSince(start);
+
+    size_t passes = 50;
+    LatencyHistogram hist;
+    start = Clock::now();
+    for (size_t i = 0; i < passes; ++i) {
+        auto t0 = Clock::now();
+        pm.sampleNow();
+        hist.record(nanosSince(t0));
+    }
+    double seconds = secondsSince(start);
+
+    for (pid_t pid : pids) {
+        kill(pid, SIGKILL);
+    }
+    while (pm.processCount() > 0) {
+        pm.updateProcessStates();
+        usleep(1000);
+    }
+
+    size_t n = pids.empty() ? 1 : pids.size();
+    Result("process_sampler")
+        .param("children", static_cast<uint64_t>(pids.size()))
+        .param("first_pass_ns_per_child", firstSeconds * 1e9 / n)
+        .param("pass_ns_per_child", passes ? seconds * 1e9 / passes / n : 0.0)
+        .rate(passes * pids.size(), seconds)
+        .latency(hist, "pass_")
+        .print();
+}
+
+// With 'children' long-running children: what one updateProcessStates()
+// costs while none has exited (it used to waitpid() every entry), then
+// how long it takes, after killing them all, until every exit has been
+// recorded by polling or by the reaper thread.
+static void benchReap(bool reaper) {
+    size_t children = 1000 / scale;
+    ProcessManager pm;
+    if (reaper) {
+        pm.startReaper();
+    }
+    std::atomic<size_t> exited(0);
+    std::vector<pid_t> pids;
+
+    for (size_t i = 0; i < children; ++i) {
+        pid_t pid = pm.createProcess({"sleep", "60"}, SpawnOptions(), [&exited](const ProcessInfo&) {
+            exited.fetch_add(1, std::memory_order_relaxed);
+        });
+        if (pid > 0) {
+            pids.push_back(pid);
+        }
+    }
+
+    size_t polls = 1000 / scale;
+    auto start = Clock::now();
+    for (size_t i = 0; i < polls; ++i) {
+        pm.updateProcessStates();
+    }
+    double pollSeconds = secondsSince(start);
+
+    start = Clock::now();
+    for (pid_t pid : pids) {
+        kill(pid, SIGKILL);
+    }
+    while (exited.load(std::memory_order_relaxed) < pids.size()) {
+        if (reaper) {
+            usleep(100);
+        } else {
+            pm.updateProcessStates();
+        }
+    }
+    double seconds = secondsSince(start);
+
+    Result("process_reap")
+        .param("mode", reaper ? "reaper" : "poll")
+        .param("children", static_cast<uint64_t>(pids.size()))
+        .param("idle_poll_ns", polls ? pollSeconds * 1e9 / polls : 0.0)
+        .rate(pids.size(), seconds)
+        .print();
+}
+
+// Round trips through a pool of pre-forked workers: one request at a time
+// for dispatch latency, then 'outstanding' at once for throughput. Compare
+// with process_spawn, which starts a new process per job.
+static void benchProcessPool(bool zygote, size_t outstanding) {
+    size_t rounds = 20000 / scale;
+    ProcessPoolConfig config;
+    config.numWorkers = 4;
+    config.zygote = zygote;
+    ProcessPool pool(config, [](const std::string& request) { return request; });
+
+    LatencyHistogram hist;
+    auto start = Clock::now();
+    for (size_t i = 0; i < rounds; ++i) {
+        auto t0 = Clock::now();
+        pool.submit("ping").get();
+        hist.record(nanosSince(t0));
+    }
+    double seconds = secondsSince(start);
+
+    Result("process_pool_round_trip")
+        .param("zygote", zygote ? "yes" : "no")
+        .param("workers", static_cast<uint64_t>(config.numWorkers))
+        .rate(hist.count(), seconds)
+        .latency(hist)
+        .print();
+
+    std::vector<std::future<std::string>> replies;
+    replies.reserve(outstanding);
+    size_t done = 0;
+    start = Clock::now();
+    for (size_t i = 0; i < rounds; i += outstanding) {
+        replies.clear();
+        for (size_t j = 0; j < outstanding; ++j) {
+            replies.push_back(pool.submit("ping"));
+        }
+        for (auto& reply : replies) {
+            reply.get();
+            ++done;
+        }
+    }
+    seconds = secondsSince(start);
+
+    Result("process_pool_throughput")
+        .param("zygote", zygote ? "yes" : "no")
+        .param("workers", static_cast<uint64_t>(config.numWorkers))
+        .param("outstanding", static_cast<uint64_t>(outstanding))
+        .rate(done, seconds)
+        .print();
+}
+
+// fork() has to copy the parent's page tables, so its cost grows with the
+// parent's resident memory; 'residentMb' of touched ballast shows that.
+static void benchSpawn(const char* methodName, SpawnMethod method, size_t residentMb) {
+    size_t rounds = 500 / scale;
+    ProcessManager pm;
+    LatencyHistogram spawnHist, lifeHist;
+    std::vector<char> ballast(residentMb << 20, 1);
+
+    SpawnOptions options;
+    options.method = method;
+
+    auto start = Clock::now();
+    for (size_t i = 0; i < rounds; ++i) {
+        auto t0 = Clock::now();
+        pid_t pid = pm.createProcess({"/bin/true"}, options);
+        if (pid < 0) {
+            break;
+        }
+        spawnHist.record(nanosSince(t0));
+        waitpid(pid, nullptr, 0);
+        lifeHist.record(nanosSince(t0));
+    }
+    double seconds = secondsSince(start);
+
+    Result("process_spawn")
+        .param("command", "/bin/true")
+        .param("method", methodName)
+        .param("resident_mb", static_cast<uint64_t>(residentMb))
+        .rate(spawnHist.count(), seconds)
+        .latency(spawnHist, "spawn_")
+        .latency(lifeHist, "exit_")
+        .print();
+}
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            scale = 10;
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--quick] [--filter <substring>]\n";
+            return 1;
+        }
+    }
+
+    const SchedulingMode modes[] = {
+        SchedulingMode::SHARED_QUEUE,
+        SchedulingMode::WORK_STEALING,
+        SchedulingMode::LOCK_FREE_RING
+    };
+    const size_t threadCounts[] = {1, 2, 4, 8};
+    const uint64_t workSizes[] = {0, 1000, 10000};
+
+    if (selected("threadpool_throughput")) {
+        for (SchedulingMode mode : modes) {
+            for (size_t threads : threadCounts) {
+                for (uint64_t work : workSizes) {
+                    std::cerr << "threadpool_throughput " << modeName(mode) << " x" << threads
+                              << " work=" << work << "ns\n";
+                    benchPoolThroughput(mode, threads, work);
+                }
+            }
+        }
+    }
+    if (selected("threadpool_submit_latency")) {
+        for (SchedulingMode mode : modes) {
+            for (size_t threads : threadCounts) {
+                std::cerr << "threadpool_submit_latency " << modeName(mode) << " x" << threads << "\n";
+                benchPoolLatency(mode, threads);
+            }
+        }
+    }
+    if (selected("pipe_round_trip")) {
+        for (size_t size : {8, 256, 4096}) {
+            std::cerr << "pipe_round_trip " << size << "B\n";
+            benchPipeRoundTrip(size);
+        }
+    }
+    if (selected("pipe_bandwidth")) {
+        for (size_t chunk : {4096, 65536}) {
+            std::cerr << "pipe_bandwidth " << chunk << "B\n";
+            benchPipeBandwidth(chunk);
+        }
+    }
+    if (selected("pipe_splice_bandwidth")) {
+        for (size_t chunk : {4096, 65536}) {
+            std::cerr << "pipe_splice_bandwidth " << chunk << "B\n";
+            benchPipeSpliceBandwidth(chunk);
+        }
+    }
+    if (selected("pipe_framed")) {
+        for (size_t size : {16, 256}) {
+            for (size_t batch : {1, 64}) {
+                std::cerr << "pipe_framed " << size << "B batch=" << batch << "\n";
+                benchPipeFramed(size, batch);
+            }
+        }
+    }
+    if (selected("pipe_io_ring")) {
+        std::cerr << "pipe_io_ring 16B batch=1\n";
+        benchPipeIoRing(16, 1, false);
+        for (bool linked : {true, false}) {
+            std::cerr << "pipe_io_ring 16B batch=64 linked=" << linked << "\n";
+            benchPipeIoRing(16, 64, linked);
+        }
+    }
+    if (selected("pipe_io_ring_loop")) {
+        std::cerr << "pipe_io_ring_loop 16B batch=64\n";
+        benchPipeIoRingLoop(16, 64);
+    }
+    if (selected("fifo_round_trip")) {
+        std::cerr << "fifo_round_trip\n";
+        benchFifoRoundTrip();
+    }
+    if (selected("fifo_channel_round_trip")) {
+        std::cerr << "fifo_channel_round_trip\n";
+        benchFifoChannelRoundTrip();
+    }
+    if (selected("shm_round_trip")) {
+        std::cerr << "shm_round_trip\n";
+        benchShmRoundTrip();
+    }
+    if (selected("shm_bandwidth")) {
+        for (size_t chunk : {4096, 1 << 20}) {
+            std::cerr << "shm_bandwidth " << chunk << "B\n";
+            benchShmBandwidth(chunk);
+        }
+    }
+    if (selected("shm_first_touch")) {
+        SegmentOptions lazy;
+        SegmentOptions populate;
+        populate.prefault = Prefault::POPULATE;
+        SegmentOptions transparent;
+        transparent.hugePages = HugePages::TRANSPARENT;
+        transparent.prefault = Prefault::POPULATE;
+        SegmentOptions explicitHuge;
+        explicitHuge.hugePages = HugePages::EXPLICIT;
+        explicitHuge.prefault = Prefault::POPULATE;
+        std::cerr << "shm_first_touch\n";
+        benchShmFirstTouch("lazy", lazy);
+        benchShmFirstTouch("populate", populate);
+        benchShmFirstTouch("thp_populate", transparent);
+        benchShmFirstTouch("hugetlb_populate", explicitHuge);
+    }
+    if (selected("shm_snapshot")) {
+        for (size_t size : {64, 65536}) {
+            std::cerr << "shm_snapshot " << size << "B x4 readers\n";
+            benchShmSnapshot(size, 4);
+        }
+    }
+    if (selected("process_table")) {
+        for (size_t entries : {1000, 50000}) {
+            std::cerr << "process_table " << entries << " entries\n";
+            benchProcessTable(entries);
+        }
+    }
+    if (selected("process_sampler")) {
+        std::cerr << "process_sampler\n";
+        benchSampler();
+    }
+    if (selected("process_reap")) {
+        for (bool reaper : {false, true}) {
+            std::cerr << "process_reap " << (reaper ? "reaper" : "poll") << "\n";
+            benchReap(reaper);
+        }
+    }
+    if (selected("process_pool")) {
+        for (bool zygote : {false, true}) {
+            std::cerr << "process_pool zygote=" << zygote << "\n";
+            benchProcessPool(zygote, 64);
+        }
+    }
+    if (selected("process_spawn")) {
+        const std::pair<const char*, SpawnMethod> methods[] = {
+            {"fork_exec", SpawnMethod::FORK_EXEC},
+            {"posix_spawn", SpawnMethod::POSIX_SPAWN},
+            {"vfork", SpawnMethod::VFORK}
+        };
+        for (size_t residentMb : {0, 512}) {
+            for (const auto& m : methods) {
+                std::cerr << "process_spawn " << m.first << " " << residentMb << "MB resident\n";
+                benchSpawn(m.first, m.second, residentMb);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include "cpu_topology.h"
+
+#include <sched.h>
+#include <dirent.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+CpuTopology CpuTopology::detect() {
+    CpuTopology topo;
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1) {
+        perror("sched_getaffinity failed");
+        CPU_ZERO(&allowed);
+        CPU_SET(0, &allowed);
+    }
+
+    DIR* dir = opendir("/sys/devices/system/node");
+    if (dir) {
+        std::vector<int> ids;
+        while (dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name.compare(0, 4, "node") == 0 && name.size() > 4
+                && name.find_first_not_of("0123456789", 4) == std::string::npos) {
+                ids.push_back(std::atoi(name.c_str() + 4));
+            }
+        }
+        closedir(dir);
+        std::sort(ids.begin(), ids.end());
+
+        for (int id : ids) {
+            std::ifstream in("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+            std::string list;
+            std::getline(in, list);
+
+            std::vector<int> cpus;
+            for (int cpu : parseCpuList(list)) {
+                if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+                    cpus.push_back(cpu);
+                }
+            }
+            // Memory-only nodes (or nodes we may not run on) get no workers.
+            if (!cpus.empty()) {
+                topo.nodeIds.push_back(id);
+                topo.nodeCpus.push_back(cpus);
+            }
+        }
+    }
+
+    if (topo.nodeIds.empty()) {
+        std::vector<int> cpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                cpus.push_back(cpu);
+            }
+        }
+        topo.nodeIds.push_back(0);
+        topo.nodeCpus.push_back(cpus);
+    }
+
+    for (size_t n = 0; n < topo.nodeCpus.size(); ++n) {
+        for (int cpu : topo.nodeCpus[n]) {
+            if (cpu >= static_cast<int>(topo.cpuToNode.size())) {
+                topo.cpuToNode.resize(cpu + 1, -1);
+            }
+            topo.cpuToNode[cpu] = static_cast<int>(n);
+        }
+    }
+    return topo;
+}
+
+int CpuTopology::nodeIndexOfCpu(int cpu) const {
+    if (cpu < 0 || cpu >= static_cast<int>(cpuToNode.size())) {
+        return -1;
+    }
+    return cpuToNode[cpu];
+}
+
+int CpuTopology::nodeIndexOfId(int id) const {
+    for (size_t i = 0; i < nodeIds.size(); ++i) {
+        if (nodeIds[i] == id) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+std::vector<int> CpuTopology::parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t comma = list.find(',', pos);
+        if (comma == std::string::npos) {
+            comma = list.size();
+        }
+        std::string range = list.substr(pos, comma - pos);
+        pos = comma + 1;
+
+        if (range.empty() || range.find_first_of("0123456789") == std::string::npos) {
+            continue;
+        }
+        size_t dash = range.find('-');
+        int first = std::atoi(range.c_str());
+        int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
@@ -0,0 +1,37 @@
+#ifndef CPU_TOPOLOGY_H
+#define CPU_TOPOLOGY_H
+
+#include <string>
+#include <vector>
+
+/*
+ * CpuTopology:
+ * CPU -> NUMA node map read from /sys/devices/system/node, limited to the
+ * CPUs this process is allowed to run on. Systems (or containers) without
+ * that directory are reported as a single node holding every allowed CPU.
+ *
+ * Nodes are addressed by index (0 .. numNodes()-1); nodeId() gives the
+ * kernel's node number, which may be sparse.
+ */
+class CpuTopology {
+public:
+    static CpuTopology detect();
+
+    size_t numNodes() const { return nodeIds.size(); }
+    int nodeId(size_t index) const { return nodeIds[index]; }
+    const std::vector<int>& cpusOfNode(size_t index) const { return nodeCpus[index]; }
+
+    // -1 if unknown
+    int nodeIndexOfCpu(int cpu) const;
+    int nodeIndexOfId(int id) const;
+
+    // Parses a kernel CPU list such as "0-3,8,10-11".
+    static std::vector<int> parseCpuList(const std::string& list);
+
+private:
+    std::vector<int> nodeIds;
+    std::vector<std::vector<int>> nodeCpus;
+    std::vector<int> cpuToNode;   // indexed by CPU number, -1 if not ours
+};
+
+#endif
@@ -0,0 +1,446 @@
+#include "event_loop.h"
+#include "thread_pool.h"
+
+#include <unistd.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <cerrno>
+#include <cstdio>
+#include <vector>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+#ifndef P_PIDFD
+#define P_PIDFD 3
+#endif
+
+static int pidfdOpen(pid_t pid) {
+    return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+}
+
+// waitid() reports what waitpid() packs into a status word; rebuild it so
+// callbacks can keep using WIFEXITED() and friends.
+static int waitStatus(const siginfo_t& info) {
+    switch (info.si_code) {
+        case CLD_EXITED: return (info.si_status & 0xff) << 8;
+        case CLD_KILLED: return info.si_status & 0x7f;
+        case CLD_DUMPED: return (info.si_status & 0x7f) | 0x80;
+        default: return -1;
+    }
+}
+
+// Reaps the child behind 'pidfd' if it has exited (P_PIDFD, which cannot
+// hit a recycled pid), or by pid on kernels before 5.4. Returns 0 while
+// it runs, 1 with its status and usage, -1 if it was reaped elsewhere.
+// The raw system call, unlike glibc's waitid(), also returns the rusage.
+static int reapPid(int pidfd, pid_t pid, int& status, struct rusage& usage) {
+    siginfo_t info;
+    long r;
+    do {
+        info.si_pid = 0;
+        r = syscall(SYS_waitid, P_PIDFD, pidfd, &info, WEXITED | WNOHANG, &usage);
+    } while (r == -1 && errno == EINTR);
+    if (r == 0) {
+        if (info.si_pid == 0) {
+            return 0;
+        }
+        status = waitStatus(info);
+        return 1;
+    }
+    if (errno == EINVAL) {
+        pid_t p;
+        do {
+            p = wait4(pid, &status, WNOHANG, &usage);
+        } while (p == -1 && errno == EINTR);
+        if (p == 0) {
+            return 0;
+        }
+        return p == pid ? 1 : -1;
+    }
+    return -1;
+}
+
+EventLoop::EventLoop(ThreadPool* pool)
+    : pool(pool), epfd(-1), wakeFd(-1), sigFd(-1), stopping(false), inFlight(0) {
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd == -1) {
+        perror("epoll_create1 failed");
+        return;
+    }
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd == -1) {
+        perror("eventfd failed");
+        close(epfd);
+        epfd = -1;
+        return;
+    }
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = wakeFd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, wakeFd, &ev);
+}
+
+EventLoop::~EventLoop() {
+    {
+        std::unique_lock<std::mutex> lock(doneMtx);
+        doneCv.wait(lock, [this] { return inFlight == 0; });
+    }
+    for (auto& entry : fds) {
+        if (entry.second->pid > 0) {
+            close(entry.first);
+        }
+    }
+    if (sigFd != -1) {
+        close(sigFd);
+    }
+    if (wakeFd != -1) {
+        close(wakeFd);
+    }
+    if (epfd != -1) {
+        close(epfd);
+    }
+}
+
+bool EventLoop::watch(int fd, uint32_t events, FdCallback cb) {
+    if (epfd == -1) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    if (fds.count(fd)) {
+        fprintf(stderr, "descriptor %d is already watched\n", fd);
+        return false;
+    }
+
+    epoll_event ev = {};
+    ev.events = events | (pool ? EPOLLONESHOT : 0);
+    ev.data.fd = fd;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        perror("epoll_ctl add failed");
+        return false;
+    }
+    fds[fd] = std::make_shared<Watch>(Watch{fd, events, std::move(cb), 0, nullptr, false});
+    return true;
+}
+
+bool EventLoop::modify(int fd, uint32_t events) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = fds.find(fd);
+    if (it == fds.end() || it->second->pid > 0) {
+        return false;
+    }
+    Watch& w = *it->second;
+    w.events = events;
+    // A callback in flight on the pool re-arms with the new events itself.
+    if (w.running) {
+        return true;
+    }
+    epoll_event ev = {};
+    ev.events = events | (pool ? EPOLLONESHOT : 0);
+    ev.data.fd = fd;
+    if (epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev) == -1) {
+        perror("epoll_ctl mod failed");
+        return false;
+    }
+    return true;
+}
+
+bool EventLoop::unwatch(int fd) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = fds.find(fd);
+    if (it == fds.end() || it->second->pid > 0) {
+        return false;
+    }
+    fds.erase(it);
+    epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
+    return true;
+}
+
+bool EventLoop::watchChild(pid_t pid, ExitCallback cb) {
+    return watchChild(pid, [cb = std::move(cb)](pid_t child, int status, const struct rusage&) {
+        cb(child, status);
+    });
+}
+
+bool EventLoop::watchChild(pid_t pid, ExitUsageCallback cb) {
+    if (epfd == -1) {
+        return false;
+    }
+
+    int pidfd = pidfdOpen(pid);
+    if (pidfd == -1 && errno != ENOSYS) {
+        perror("pidfd_open failed");
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if (pidfd == -1) {
+        if (sigFd == -1 && !enableSignalFallback()) {
+            return false;
+        }
+        children[pid] = std::make_shared<Watch>(Watch{-1, 0, nullptr, pid, std::move(cb), false});
+        // The child may have exited before SIGCHLD was routed to sigFd;
+        // a pending SIGCHLD makes the loop look at it either way.
+        kill(getpid(), SIGCHLD);
+        return true;
+    }
+
+    // A pidfd becomes readable once the process has exited.
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = pidfd;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, pidfd, &ev) == -1) {
+        perror("epoll_ctl add failed");
+        close(pidfd);
+        return false;
+    }
+    fds[pidfd] = std::make_shared<Watch>(Watch{pidfd, EPOLLIN, nullptr, pid, std::move(cb), false});
+    return true;
+}
+
+// Called with mtx held.
+bool EventLoop::enableSignalFallback() {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGCHLD);
+    pthread_sigmask(SIG_BLOCK, &set, nullptr);
+
+    sigFd = signalfd(-1, &set, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (sigFd == -1) {
+        perror("signalfd failed");
+        return false;
+    }
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = sigFd;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, sigFd, &ev) == -1) {
+        perror("epoll_ctl add failed");
+        close(sigFd);
+        sigFd = -1;
+        return false;
+    }
+    return true;
+}
+
+size_t EventLoop::watched() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return fds.size() + children.size();
+}
+
+int EventLoop::runOnce(int timeoutMs) {
+    if (epfd == -1) {
+        return -1;
+    }
+    int n = epoll_wait(epfd, events, MAX_EVENTS, timeoutMs);
+    if (n == -1) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        perror("epoll_wait failed");
+        return -1;
+    }
+
+    int handled = 0;
+    for (int i = 0; i < n; ++i) {
+        int fd = events[i].data.fd;
+        if (fd == wakeFd) {
+            uint64_t count;
+            while (read(wakeFd, &count, sizeof(count)) > 0) {
+            }
+            continue;
+        }
+        if (fd == sigFd) {
+            reapSignalled();
+            ++handled;
+            continue;
+        }
+
+        std::shared_ptr<Watch> w;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            auto it = fds.find(fd);
+            if (it == fds.end()) {
+                continue;   // unwatched after epoll_wait returned
+            }
+            w = it->second;
+            if (pool && w->pid == 0) {
+                w->running = true;
+            }
+        }
+        if (w->pid > 0) {
+            reapChild(w);
+        } else {
+            dispatch(w, events[i].events);
+        }
+        ++handled;
+    }
+    return handled;
+}
+
+void EventLoop::run() {
+    while (!stopping.load(std::memory_order_acquire)) {
+        if (runOnce(-1) == -1) {
+            break;
+        }
+    }
+    stopping.store(false, std::memory_order_relaxed);
+}
+
+void EventLoop::stop() {
+    stopping.store(true, std::memory_order_release);
+    uint64_t one = 1;
+    if (write(wakeFd, &one, sizeof(one)) == -1 && errno != EAGAIN) {
+        perror("event loop wakeup failed");
+    }
+}
+
+// Dispatch
+
+void EventLoop::dispatch(const std::shared_ptr<Watch>& w, uint32_t ev) {
+    if (!pool) {
+        w->onReady(w->fd, ev);
+        return;
+    }
+    if (pool->isStopping()) {
+        // Nothing would run it and the destructor would wait for it forever.
+        // The descriptor stays disarmed.
+        fprintf(stderr, "EventLoop: thread pool shut down, dropping callback for fd %d\n", w->fd);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(doneMtx);
+        ++inFlight;
+    }
+    pool->post([this, w, ev]() {
+        w->onReady(w->fd, ev);
+        rearm(w);
+        taskDone();
+    });
+}
+
+void EventLoop::dispatchExit(const std::shared_ptr<Watch>& w, int status, const struct rusage& usage) {
+    if (!pool) {
+        w->onExit(w->pid, status, usage);
+        return;
+    }
+    if (pool->isStopping()) {
+        fprintf(stderr, "EventLoop: thread pool shut down, dropping exit callback for pid %d\n",
+                static_cast<int>(w->pid));
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(doneMtx);
+        ++inFlight;
+    }
+    pool->post([this, w, status, usage]() {
+        w->onExit(w->pid, status, usage);
+        taskDone();
+    });
+}
+
+// Re-enables a one-shot descriptor after its callback, unless it was
+// unwatched (and the number possibly reused) in the meantime.
+void EventLoop::rearm(const std::shared_ptr<Watch>& w) {
+    std::lock_guard<std::mutex> lock(mtx);
+    w->running = false;
+    auto it = fds.find(w->fd);
+    if (it == fds.end() || it->second != w) {
+        return;
+    }
+    epoll_event ev = {};
+    ev.events = w->events | EPOLLONESHOT;
+    ev.data.fd = w->fd;
+    if (epoll_ctl(epfd, EPOLL_CTL_MOD, w->fd, &ev) == -1) {
+        perror("epoll_ctl rearm failed");
+    }
+}
+
+void EventLoop::taskDone() {
+    std::lock_guard<std::mutex> lock(doneMtx);
+    if (--inFlight == 0) {
+        doneCv.notify_all();
+    }
+}
+
+// Child exits
+
+// The pidfd is readable, so the child has exited; reap it and drop the pidfd.
+void EventLoop::reapChild(const std::shared_ptr<Watch>& w) {
+    int status = 0;
+    struct rusage usage = {};
+    int r = reapPid(w->fd, w->pid, status, usage);
+    if (r == 0) {
+        return;
+    }
+    if (r == -1) {
+        status = -1;   // reaped by someone else
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        fds.erase(w->fd);
+        epoll_ctl(epfd, EPOLL_CTL_DEL, w->fd, nullptr);
+    }
+    close(w->fd);
+    dispatchExit(w, status, usage);
+}
+
+// signalfd fallback: SIGCHLD does not say which child and several exits
+// may share one signal. Peek at exited children with waitid(WNOWAIT) and
+// reap the watched ones directly; only a zombie the loop does not watch
+// forces a scan of every watched child.
+void EventLoop::reapSignalled() {
+    signalfd_siginfo info;
+    while (read(sigFd, &info, sizeof(info)) == sizeof(info)) {
+    }
+
+    struct Exited {
+        std::shared_ptr<Watch> watch;
+        int status;
+        struct rusage usage;
+    };
+    std::vector<Exited> exited;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        bool scan = false;
+        while (!children.empty()) {
+            siginfo_t peek;
+            peek.si_pid = 0;
+            if (waitid(P_ALL, 0, &peek, WEXITED | WNOHANG | WNOWAIT) == -1 || peek.si_pid == 0) {
+                break;
+            }
+            auto it = children.find(peek.si_pid);
+            if (it == children.end()) {
+                scan = true;
+                break;
+            }
+            Exited e{it->second, 0, {}};
+            if (wait4(peek.si_pid, &e.status, WNOHANG, &e.usage) != peek.si_pid) {
+                e.status = -1;
+            }
+            exited.push_back(e);
+            children.erase(it);
+        }
+
+        for (auto it = children.begin(); scan && it != children.end();) {
+            Exited e{it->second, 0, {}};
+            pid_t r = wait4(it->first, &e.status, WNOHANG, &e.usage);
+            if (r == 0 || (r == -1 && errno == EINTR)) {
+                ++it;
+                continue;
+            }
+            if (r == -1) {
+                e.status = -1;
+            }
+            exited.push_back(e);
+            it = children.erase(it);
+        }
+    }
+    for (const Exited& e : exited) {
+        dispatchExit(e.watch, e.status, e.usage);
+    }
+}
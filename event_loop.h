@@ -0,0 +1,127 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+
+class ThreadPool;
+
+/*
+ * EventLoop:
+ * epoll reactor for many pipe / FIFO / socket descriptors plus child
+ * process exits, driven by a single thread calling run() or runOnce().
+ *
+ * Descriptors are level-triggered unless EPOLLET is passed. Child exits
+ * are watched through a pidfd (pidfd_open); on kernels without it the
+ * loop falls back to a signalfd for SIGCHLD, which requires SIGCHLD to be
+ * blocked in every thread (block it before starting any thread).
+ * Exited children are reaped by the loop (waitid() on the pidfd) and
+ * their wait status handed to the callback.
+ *
+ * Without a pool, callbacks run on the loop thread. With a pool, each
+ * readiness event is posted to it as a task; the descriptor is armed
+ * EPOLLONESHOT and re-armed when the callback returns, so one descriptor
+ * never has two callbacks running at once.
+ *
+ * watch/unwatch/watchChild/stop may be called from any thread, including
+ * from callbacks. The destructor waits for callbacks still on the pool, so
+ * the pool must outlive the loop and must not be shut down while the loop
+ * still runs. Events that come in once the pool is shutting down are
+ * dropped, with a message on stderr, instead of being posted to a pool
+ * that would never run them.
+ */
+class EventLoop {
+public:
+    using FdCallback = std::function<void(int fd, uint32_t events)>;
+    using ExitCallback = std::function<void(pid_t pid, int status)>;
+    using ExitUsageCallback = std::function<void(pid_t pid, int status, const struct rusage& usage)>;
+
+    explicit EventLoop(ThreadPool* pool = nullptr);
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // epoll instance and wakeup descriptor were created
+    bool isOpen() const { return epfd != -1; }
+
+    // Calls cb(fd, events) whenever 'fd' is ready for 'events'
+    // (EPOLLIN, EPOLLOUT, ...; EPOLLHUP/EPOLLERR are always reported).
+    // The loop does not take ownership of 'fd'.
+    bool watch(int fd, uint32_t events, FdCallback cb);
+
+    // Changes the events a watched descriptor waits for.
+    bool modify(int fd, uint32_t events);
+
+    // Stops watching 'fd'; call before closing it. A callback already
+    // dispatched to the pool may still be running.
+    bool unwatch(int fd);
+
+    // Calls cb(pid, status) once child 'pid' has exited and been reaped;
+    // 'status' is the waitpid() status, or -1 if someone else reaped it.
+    bool watchChild(pid_t pid, ExitCallback cb);
+
+    // Same, also handing over the child's resource usage as wait4()
+    // reports it (all zero if someone else reaped it).
+    bool watchChild(pid_t pid, ExitUsageCallback cb);
+
+    // Descriptors plus children being watched
+    size_t watched() const;
+
+    // Waits up to 'timeoutMs' (-1: forever) and dispatches what is ready.
+    // Returns the number of events dispatched, -1 on error.
+    int runOnce(int timeoutMs = -1);
+
+    // runOnce() until stop()
+    void run();
+
+    // Makes run() return; safe from any thread or callback.
+    void stop();
+
+private:
+    struct Watch {
+        int fd;
+        uint32_t events;
+        FdCallback onReady;
+        pid_t pid;              // child watches only
+        ExitUsageCallback onExit;
+        bool running;           // pool callback in flight, descriptor disarmed
+    };
+
+    static const int MAX_EVENTS = 256;
+
+    bool enableSignalFallback();
+    void dispatch(const std::shared_ptr<Watch>& w, uint32_t events);
+    void dispatchExit(const std::shared_ptr<Watch>& w, int status, const struct rusage& usage);
+    void rearm(const std::shared_ptr<Watch>& w);
+    void reapChild(const std::shared_ptr<Watch>& w);
+    void reapSignalled();
+    void taskDone();
+
+    ThreadPool* pool;
+    int epfd;
+    int wakeFd;
+    int sigFd;                  // SIGCHLD fallback, -1 until needed
+    std::atomic<bool> stopping;
+
+    mutable std::mutex mtx;
+    std::unordered_map<int, std::shared_ptr<Watch>> fds;          // by fd, pidfds included
+    std::unordered_map<pid_t, std::shared_ptr<Watch>> children;   // signalfd fallback only
+
+    // Callbacks posted to the pool and not finished yet
+    std::mutex doneMtx;
+    std::condition_variable doneCv;
+    size_t inFlight;
+
+    epoll_event events[MAX_EVENTS];
+};
+
+#endif
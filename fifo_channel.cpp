@@ -0,0 +1,103 @@
+#include "fifo_channel.h"
+#include "ipc_manager.h"
+
+#include <unistd.h>
+#include <fcntl.h>
+
+FifoChannel::FifoChannel() : fd_(-1), dir(Direction::READ) {}
+
+FifoChannel::~FifoChannel() {
+    close();
+}
+
+bool FifoChannel::open(const std::string& path, Direction direction, const FifoOptions& options) {
+    close();
+
+    if (options.create && !IPCManager::createFIFO(path, options.mode)) {
+        return false;
+    }
+
+    int flags;
+    if (direction == Direction::WRITE) {
+        flags = O_WRONLY;
+    } else {
+        flags = options.keepAlive ? O_RDWR : O_RDONLY;
+    }
+    if (options.nonBlocking) {
+        flags |= O_NONBLOCK;
+    }
+
+    int fd = IPCManager::openFIFO(path, flags);
+    if (fd == -1) {
+        return false;
+    }
+
+    fd_ = fd;
+    dir = direction;
+    path_ = path;
+    reader.reset(direction == Direction::READ ? fd : -1);
+    return true;
+}
+
+void FifoChannel::close() {
+    if (fd_ != -1) {
+        ::close(fd_);
+    }
+    fd_ = -1;
+    path_.clear();
+    reader.reset(-1);
+}
+
+// Writer
+
+bool FifoChannel::send(const void* data, size_t len) {
+    if (fd_ == -1 || dir != Direction::WRITE) {
+        return false;
+    }
+    return IPCManager::writeFrame(fd_, data, len);
+}
+
+bool FifoChannel::send(const std::string& msg) {
+    return send(msg.data(), msg.size());
+}
+
+bool FifoChannel::sendBatch(const std::vector<std::string>& msgs) {
+    if (fd_ == -1 || dir != Direction::WRITE) {
+        return false;
+    }
+    return IPCManager::writeFrames(fd_, msgs);
+}
+
+// Reader
+
+FrameReader::Status FifoChannel::receive(std::string& out) {
+    if (fd_ == -1 || dir != Direction::READ) {
+        return FrameReader::Status::ERROR;
+    }
+    return reader.receive(out);
+}
+
+FrameReader::Status FifoChannel::receiveBatch(std::vector<std::string>& out, size_t max) {
+    if (fd_ == -1 || dir != Direction::READ) {
+        out.clear();
+        return FrameReader::Status::ERROR;
+    }
+
+    size_t n = 0;
+    FrameReader::Status s = FrameReader::Status::OK;
+    while (n < max) {
+        if (n > 0 && !reader.hasFrame()) {
+            break;
+        }
+        if (n == out.size()) {
+            out.emplace_back();
+        }
+        s = reader.receive(out[n]);
+        if (s != FrameReader::Status::OK) {
+            break;
+        }
+        ++n;
+    }
+    out.resize(n);
+    return n > 0 ? FrameReader::Status::OK : s;
+}
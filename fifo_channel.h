@@ -0,0 +1,111 @@
+#ifndef FIFO_CHANNEL_H
+#define FIFO_CHANNEL_H
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <sys/types.h>
+
+#include "frame_reader.h"
+
+struct FifoOptions {
+    // Open with O_NONBLOCK. A non-blocking writer can only open once a
+    // reader has the FIFO open; a non-blocking reader gets AGAIN from
+    // receive() when no whole message is buffered. send() is unaffected:
+    // a frame is never left half-written, so on a full FIFO it still
+    // polls until the whole message is in.
+    bool nonBlocking = false;
+
+    // mkfifo() the path first if it does not exist
+    bool create = true;
+    mode_t mode = 0666;
+
+    // Reader only: also hold a write reference (O_RDWR), so the channel
+    // survives writers coming and going instead of reporting CLOSED when
+    // the last one exits. Also makes a blocking open() return at once.
+    bool keepAlive = false;
+};
+
+/*
+ * FifoChannel:
+ * One end of a named pipe, opened once and kept open across messages.
+ * IPCManager::writeToFIFO / readFromFIFO reopen the path for every
+ * message (a path lookup, a rendezvous with the other side and two extra
+ * system calls each); a long-lived producer/consumer pair should hold a
+ * FifoChannel on each side instead.
+ *
+ * Messages use the framed format of IPCManager::writeFrame, so they are
+ * binary-safe and keep their boundaries. Batches go out with one writev()
+ * and come back from as few read()s as the kernel allows.
+ */
+class FifoChannel {
+public:
+    enum class Direction {
+        READ,
+        WRITE
+    };
+
+    FifoChannel();
+    ~FifoChannel();
+
+    FifoChannel(const FifoChannel&) = delete;
+    FifoChannel& operator=(const FifoChannel&) = delete;
+
+    // Opens 'path' for one direction. A blocking open waits for the other
+    // side, like open(2) on a FIFO.
+    bool open(const std::string& path, Direction dir, const FifoOptions& options = FifoOptions());
+
+    // Closes the descriptor; the FIFO file itself stays.
+    void close();
+
+    bool isOpen() const { return fd_ != -1; }
+    int fd() const { return fd_; }
+    const std::string& path() const { return path_; }
+
+    // -------------------------------
+    // Writer
+    // -------------------------------
+
+    // Writes the whole frame, waiting for room if the FIFO is full (even
+    // when opened nonBlocking).
+    bool send(const void* data, size_t len);
+    bool send(const std::string& msg);
+
+    // Gathers the batch straight from 'msgs' with one writev() per
+    // IPCManager::FRAMES_PER_WRITE messages. A batch written by a single
+    // writev() is atomic with other writers if it fits in PIPE_BUF
+    // (4 bytes of header per message).
+    bool sendBatch(const std::vector<std::string>& msgs);
+
+    // -------------------------------
+    // Reader
+    // -------------------------------
+
+    FrameReader::Status receive(std::string& out);
+
+    // Replaces 'out' with up to 'max' messages. Only the first one may
+    // wait on the descriptor; the rest are whatever is already buffered.
+    // Returns OK if at least one message was read, otherwise the status
+    // that stopped the first.
+    FrameReader::Status receiveBatch(std::vector<std::string>& out, size_t max = SIZE_MAX);
+
+    // Same, handing each message in place to fn(const char*, size_t)
+    template <typename F>
+    FrameReader::Status drain(F&& fn, size_t max = SIZE_MAX);
+
+private:
+    int fd_;
+    Direction dir;
+    std::string path_;
+    FrameReader reader;
+};
+
+template <typename F>
+FrameReader::Status FifoChannel::drain(F&& fn, size_t max) {
+    if (fd_ == -1 || dir != Direction::READ) {
+        return FrameReader::Status::ERROR;
+    }
+    return reader.drain(std::forward<F>(fn), max);
+}
+
+#endif
@@ -0,0 +1,103 @@
+#include "frame_reader.h"
+
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+FrameReader::FrameReader(int fd, size_t maxFrame, size_t bufferSize)
+    : fd_(fd), maxFrame(maxFrame), buf(bufferSize < HEADER ? HEADER : bufferSize), begin(0), end(0) {}
+
+void FrameReader::reset(int fd) {
+    fd_ = fd;
+    begin = 0;
+    end = 0;
+}
+
+FrameReader::Status FrameReader::next(const char*& data, size_t& length) {
+    while (true) {
+        size_t avail = end - begin;
+        if (avail == 0) {
+            begin = 0;
+            end = 0;
+        }
+
+        size_t need = HEADER;
+        if (avail >= HEADER) {
+            uint32_t len;
+            memcpy(&len, buf.data() + begin, sizeof(len));
+            if (len > maxFrame) {
+                fprintf(stderr, "frame of %u bytes exceeds limit of %zu\n", len, maxFrame);
+                return Status::ERROR;
+            }
+            need = HEADER + len;
+            if (avail >= need) {
+                data = buf.data() + begin + HEADER;
+                length = len;
+                begin += need;
+                return Status::OK;
+            }
+        }
+
+        // Make room for the rest of the frame: slide the partial frame to
+        // the front, and grow only if the frame itself is bigger.
+        if (begin + need > buf.size()) {
+            memmove(buf.data(), buf.data() + begin, avail);
+            begin = 0;
+            end = avail;
+            if (need > buf.size()) {
+                buf.resize(need);
+            }
+        }
+
+        Status s = fill();
+        if (s != Status::OK) {
+            return s;
+        }
+    }
+}
+
+FrameReader::Status FrameReader::receive(std::string& out) {
+    const char* data;
+    size_t length;
+    Status s = next(data, length);
+    if (s == Status::OK) {
+        out.assign(data, length);
+    }
+    return s;
+}
+
+bool FrameReader::hasFrame() const {
+    if (end - begin < HEADER) {
+        return false;
+    }
+    uint32_t len;
+    memcpy(&len, buf.data() + begin, sizeof(len));
+    return end - begin >= HEADER + len;
+}
+
+// One read() into the free tail of the buffer.
+FrameReader::Status FrameReader::fill() {
+    while (true) {
+        ssize_t n = read(fd_, buf.data() + end, buf.size() - end);
+        if (n > 0) {
+            end += n;
+            return Status::OK;
+        }
+        if (n == 0) {
+            if (end != begin) {
+                fprintf(stderr, "stream closed in the middle of a frame\n");
+                return Status::ERROR;
+            }
+            return Status::CLOSED;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return Status::AGAIN;
+        }
+        perror("read frame failed");
+        return Status::ERROR;
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef FRAME_READER_H
+#define FRAME_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * FrameReader:
+ * Receive side of the length-prefixed message format written by
+ * IPCManager::writeFrame / sendFrame:
+ *
+ *   [payload length:4][payload ...]
+ *
+ * Attach one reader to the read end of a pipe or FIFO and keep it for the
+ * life of the descriptor. It owns a receive buffer that is reused for
+ * every message; each read() pulls in as much as the kernel has, so a
+ * burst of small frames costs one system call, and a frame split across
+ * several reads is put back together. Payloads are binary-safe.
+ *
+ * Works on blocking and O_NONBLOCK descriptors (AGAIN means no complete
+ * frame is available yet). The reader does not close the descriptor.
+ */
+class FrameReader {
+public:
+    enum class Status {
+        OK,        // a message was returned
+        AGAIN,     // non-blocking descriptor has no complete frame yet
+        CLOSED,    // writer closed the descriptor between frames
+        ERROR      // read failed, stream truncated or frame too large
+    };
+
+    // Length prefix in front of every payload
+    static const size_t HEADER = sizeof(uint32_t);
+
+    // Frames announcing more than this are treated as a corrupt stream
+    static const size_t DEFAULT_MAX_FRAME = size_t(16) << 20;
+
+    // Receive buffer, i.e. the most one read() can pull in. It only grows
+    // past this to hold a single frame that is larger.
+    static const size_t DEFAULT_BUFFER = 64 * 1024;
+
+    explicit FrameReader(int fd = -1, size_t maxFrame = DEFAULT_MAX_FRAME,
+                         size_t bufferSize = DEFAULT_BUFFER);
+
+    FrameReader(const FrameReader&) = delete;
+    FrameReader& operator=(const FrameReader&) = delete;
+
+    // Attaches to another descriptor and drops anything still buffered.
+    void reset(int fd);
+
+    int fd() const { return fd_; }
+
+    // Next message in place; 'data' stays valid until the next call.
+    Status next(const char*& data, size_t& length);
+
+    // next() + copy into 'out'
+    Status receive(std::string& out);
+
+    // Hands messages (at most 'max') to fn(const char*, size_t) in place.
+    // Only the first may wait on the descriptor; after that it stops at
+    // the end of what one read() brought in. Returns OK if at least one
+    // message was handled, otherwise the status that stopped the first.
+    template <typename F>
+    Status drain(F&& fn, size_t max = SIZE_MAX);
+
+    // True if the buffer already holds a whole frame, so next() will not
+    // touch the descriptor.
+    bool hasFrame() const;
+
+    // Bytes read from the descriptor but not yet returned as messages
+    size_t buffered() const { return end - begin; }
+
+private:
+    Status fill();
+
+    int fd_;
+    size_t maxFrame;
+    std::vector<char> buf;
+    size_t begin;   // first unconsumed byte
+    size_t end;     // one past the last byte read
+};
+
+template <typename F>
+FrameReader::Status FrameReader::drain(F&& fn, size_t max) {
+    size_t handled = 0;
+    const char* data;
+    size_t length;
+    while (handled < max && (handled == 0 || hasFrame())) {
+        Status s = next(data, length);
+        if (s != Status::OK) {
+            return handled ? Status::OK : s;
+        }
+        fn(data, length);
+        ++handled;
+    }
+    return Status::OK;
+}
+
+#endif
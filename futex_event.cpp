@@ -0,0 +1,69 @@
+#include "futex_event.h"
+
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <cerrno>
+#include <cstdio>
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "futex word must be a plain 32-bit integer");
+
+// No FUTEX_PRIVATE_FLAG: the word may be mapped by several processes.
+static long futexWait(std::atomic<uint32_t>* word, uint32_t expected, const timespec* deadline) {
+    return syscall(SYS_futex, reinterpret_cast<uint32_t*>(word),
+                   FUTEX_WAIT_BITSET, expected, deadline, nullptr, FUTEX_BITSET_MATCH_ANY);
+}
+
+static long futexWake(std::atomic<uint32_t>* word, int count) {
+    return syscall(SYS_futex, reinterpret_cast<uint32_t*>(word),
+                   FUTEX_WAKE, count, nullptr, nullptr, 0);
+}
+
+uint32_t FutexEvent::prepareWait() {
+    waiters.fetch_add(1, std::memory_order_seq_cst);
+    // Pairs with the fence in notify(): either the notifier sees us in
+    // 'waiters' or we see the condition it made true.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return seq.load(std::memory_order_acquire);
+}
+
+void FutexEvent::cancelWait() {
+    waiters.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool FutexEvent::wait(uint32_t token, const timespec* deadline) {
+    bool ok = true;
+    if (futexWait(&seq, token, deadline) == -1) {
+        if (errno == ETIMEDOUT) {
+            ok = false;
+        } else if (errno != EAGAIN && errno != EINTR) {
+            perror("futex wait failed");
+        }
+    }
+    waiters.fetch_sub(1, std::memory_order_relaxed);
+    return ok;
+}
+
+void FutexEvent::notify(int count) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+    seq.fetch_add(1, std::memory_order_release);
+    if (futexWake(&seq, count) == -1) {
+        perror("futex wake failed");
+    }
+}
+
+timespec futexDeadline(int timeoutMs) {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += timeoutMs / 1000;
+    ts.tv_nsec += static_cast<long>(timeoutMs % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec += 1;
+        ts.tv_nsec -= 1000000000;
+    }
+    return ts;
+}
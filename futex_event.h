@@ -0,0 +1,48 @@
+#ifndef FUTEX_EVENT_H
+#define FUTEX_EVENT_H
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+
+/*
+ * FutexEvent:
+ * Wakeup primitive that can live inside shared memory (all-zero bytes are
+ * a valid initial state) and works across processes. Waiters sleep in the
+ * kernel on a futex word; notify() only makes a system call when somebody
+ * is actually waiting, so the common, uncontended path is a fence and a
+ * load.
+ *
+ * Waiting always follows the same pattern so a notify() between the check
+ * and the sleep is never lost:
+ *
+ *   uint32_t token = ev.prepareWait();
+ *   if (condition) { ev.cancelWait(); ... }
+ *   else ev.wait(token, deadline);
+ *
+ * and the notifying side makes the condition true *before* notify().
+ */
+struct FutexEvent {
+    std::atomic<uint32_t> seq;       // futex word, bumped by notify()
+    std::atomic<uint32_t> waiters;   // threads between prepareWait() and the end of wait()
+
+    // Registers the caller as a waiter; returns the token for wait().
+    uint32_t prepareWait();
+
+    // Unregisters after prepareWait() when no wait is needed.
+    void cancelWait();
+
+    // Sleeps until notify() or 'deadline' (CLOCK_MONOTONIC, nullptr for no
+    // limit), then unregisters. Returns false on timeout. May return early
+    // on a signal, so callers re-check their condition.
+    bool wait(uint32_t token, const timespec* deadline);
+
+    // Wakes up to 'count' waiters if there are any.
+    void notify(int count = INT_MAX);
+};
+
+// Absolute CLOCK_MONOTONIC time 'timeoutMs' from now
+timespec futexDeadline(int timeoutMs);
+
+#endif
@@ -0,0 +1,360 @@
+#include "io_ring.h"
+#include "event_loop.h"
+
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+static int uringSetup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(syscall(SYS_io_uring_setup, entries, params));
+}
+
+static int uringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return static_cast<int>(syscall(SYS_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+static int uringRegister(int fd, unsigned opcode, void* arg, unsigned count) {
+    return static_cast<int>(syscall(SYS_io_uring_register, fd, opcode, arg, count));
+}
+
+static unsigned* ringField(void* base, uint32_t offset) {
+    return reinterpret_cast<unsigned*>(static_cast<char*>(base) + offset);
+}
+
+static unsigned loadAcquire(const unsigned* p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static void storeRelease(unsigned* p, unsigned v) {
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+static unsigned roundUpPow2(unsigned n) {
+    unsigned v = 1;
+    while (v < n) {
+        v <<= 1;
+    }
+    return v;
+}
+
+IoRing::IoRing(unsigned entries, bool inOrder)
+    : ringFd(-1), evFd(-1), attached(nullptr), ordered(inOrder), lastFd(-1), lastIndex(0),
+      sqMap(nullptr), sqMapSize(0), cqMap(nullptr), cqMapSize(0),
+      sqes(nullptr), sqesSize(0),
+      sqHead(nullptr), sqTail(nullptr), sqArray(nullptr), sqMask(0), sqEntries(0),
+      cqHead(nullptr), cqTail(nullptr), cqes(nullptr), cqMask(0), cqEntries(0),
+      localTail(0), doneHead(0), queued(0), submitted(0) {
+    if (entries == 0) {
+        entries = 1;
+    }
+    evFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (evFd == -1) {
+        perror("eventfd failed");
+    }
+
+    if (!setupUring(entries)) {
+        // Same limits as the kernel would give us
+        sqEntries = roundUpPow2(entries);
+        cqEntries = 2 * sqEntries;
+        pendingOps.reserve(sqEntries);
+        done.reserve(cqEntries);
+    }
+}
+
+IoRing::~IoRing() {
+    detach();
+    if (sqes) {
+        munmap(sqes, sqesSize);
+    }
+    if (cqMap && cqMap != sqMap) {
+        munmap(cqMap, cqMapSize);
+    }
+    if (sqMap) {
+        munmap(sqMap, sqMapSize);
+    }
+    if (ringFd != -1) {
+        close(ringFd);
+    }
+    if (evFd != -1) {
+        close(evFd);
+    }
+}
+
+// Returns false, leaving everything unset, if io_uring is unavailable
+// (old kernel, disabled by sysctl or seccomp) or lacks READ/WRITE.
+bool IoRing::setupUring(unsigned entries) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = uringSetup(entries, &params);
+    if (fd == -1) {
+        return false;
+    }
+
+    // IORING_OP_READ/WRITE arrived after io_uring itself.
+    size_t probeSize = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+    std::vector<char> probeBuf(probeSize, 0);
+    io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(probeBuf.data());
+    if (uringRegister(fd, IORING_REGISTER_PROBE, probe, 256) == -1
+        || probe->last_op < IORING_OP_WRITE
+        || !(probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED)
+        || !(probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED)) {
+        close(fd);
+        return false;
+    }
+
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single && cqSize > sqSize) {
+        sqSize = cqSize;
+    }
+
+    void* sq = mmap(nullptr, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) {
+        perror("mmap io_uring SQ failed");
+        close(fd);
+        return false;
+    }
+    void* cq = sq;
+    if (!single) {
+        cq = mmap(nullptr, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED) {
+            perror("mmap io_uring CQ failed");
+            munmap(sq, sqSize);
+            close(fd);
+            return false;
+        }
+    }
+    size_t sqeSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqeMap = mmap(nullptr, sqeSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqeMap == MAP_FAILED) {
+        perror("mmap io_uring SQEs failed");
+        if (cq != sq) {
+            munmap(cq, cqSize);
+        }
+        munmap(sq, sqSize);
+        close(fd);
+        return false;
+    }
+
+    if (evFd != -1 && uringRegister(fd, IORING_REGISTER_EVENTFD, &evFd, 1) == -1) {
+        perror("io_uring eventfd registration failed");
+    }
+
+    ringFd = fd;
+    sqMap = sq;
+    sqMapSize = sqSize;
+    cqMap = cq;
+    cqMapSize = single ? 0 : cqSize;
+    sqes = static_cast<io_uring_sqe*>(sqeMap);
+    sqesSize = sqeSize;
+
+    sqHead = ringField(sq, params.sq_off.head);
+    sqTail = ringField(sq, params.sq_off.tail);
+    sqArray = ringField(sq, params.sq_off.array);
+    sqMask = *ringField(sq, params.sq_off.ring_mask);
+    sqEntries = *ringField(sq, params.sq_off.ring_entries);
+    cqHead = ringField(cq, params.cq_off.head);
+    cqTail = ringField(cq, params.cq_off.tail);
+    cqes = reinterpret_cast<io_uring_cqe*>(static_cast<char*>(cq) + params.cq_off.cqes);
+    cqMask = *ringField(cq, params.cq_off.ring_mask);
+    cqEntries = *ringField(cq, params.cq_off.ring_entries);
+    localTail = *sqTail;
+    return true;
+}
+
+// Submission
+
+bool IoRing::prepRead(int fd, void* buf, unsigned len, uint64_t tag) {
+    return prep(IORING_OP_READ, fd, buf, len, tag);
+}
+
+bool IoRing::prepWrite(int fd, const void* buf, unsigned len, uint64_t tag) {
+    return prep(IORING_OP_WRITE, fd, const_cast<void*>(buf), len, tag);
+}
+
+bool IoRing::prep(uint8_t opcode, int fd, void* buf, unsigned len, uint64_t tag) {
+    // Never have more in flight than the completion queue can hold.
+    if (inFlight() >= cqEntries) {
+        return false;
+    }
+
+    if (ringFd == -1) {
+        if (pendingOps.size() == sqEntries) {
+            runFallback();
+        }
+        if (ordered && !pendingOps.empty() && pendingOps.back().fd == fd) {
+            pendingOps.back().linked = true;
+        }
+        pendingOps.push_back(Pending{opcode, fd, buf, len, tag, false});
+        ++queued;
+        return true;
+    }
+
+    if (localTail - loadAcquire(sqHead) == sqEntries && submit() == -1) {
+        return false;
+    }
+    // While anything is queued, the last queued SQE is still ours to change.
+    if (ordered && queued > 0 && lastFd == fd) {
+        sqes[lastIndex].flags |= IOSQE_IO_LINK;
+    }
+    unsigned index = localTail & sqMask;
+    io_uring_sqe* sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buf);
+    sqe->len = len;
+    sqe->off = static_cast<uint64_t>(-1);   // current position; pipes have none
+    sqe->user_data = tag;
+    sqArray[index] = index;
+    lastFd = fd;
+    lastIndex = index;
+    ++localTail;
+    ++queued;
+    return true;
+}
+
+int IoRing::enter(unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    while (true) {
+        int n = uringEnter(ringFd, toSubmit, minComplete, flags);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        return n;
+    }
+}
+
+int IoRing::submit() {
+    if (queued == 0) {
+        return 0;
+    }
+    if (ringFd == -1) {
+        int n = static_cast<int>(queued);
+        runFallback();
+        return n;
+    }
+
+    storeRelease(sqTail, localTail);
+    int n = enter(static_cast<unsigned>(queued), 0, 0);
+    if (n == -1) {
+        perror("io_uring_enter failed");
+        return -1;
+    }
+    queued -= n;
+    submitted += n;
+    return n;
+}
+
+bool IoRing::submitAndWait(unsigned minComplete) {
+    if (ringFd == -1) {
+        // Fallback operations complete inside submit().
+        return submit() != -1;
+    }
+    storeRelease(sqTail, localTail);
+    int n = enter(static_cast<unsigned>(queued), minComplete, IORING_ENTER_GETEVENTS);
+    if (n == -1) {
+        perror("io_uring_enter failed");
+        return false;
+    }
+    queued -= n;
+    submitted += n;
+    return true;
+}
+
+// Completion
+
+void IoRing::ackEvent() {
+    uint64_t count;
+    if (evFd != -1 && read(evFd, &count, sizeof(count)) == -1 && errno != EAGAIN) {
+        perror("eventfd read failed");
+    }
+}
+
+bool IoRing::attach(EventLoop& loop, std::function<void(const Completion&)> fn) {
+    if (evFd == -1) {
+        return false;
+    }
+    detach();
+    // The loop owns the callback, so 'fn' outlives a detach() made from it.
+    if (!loop.watch(evFd, EPOLLIN, [this, fn = std::move(fn)](int, uint32_t) {
+            ackEvent();
+            reap(fn);
+        })) {
+        return false;
+    }
+    attached = &loop;
+    return true;
+}
+
+void IoRing::detach() {
+    if (attached) {
+        attached->unwatch(evFd);
+        attached = nullptr;
+    }
+}
+
+bool IoRing::peek(Completion& out) {
+    if (ringFd == -1) {
+        if (doneHead == done.size()) {
+            return false;
+        }
+        out = done[doneHead];
+        return true;
+    }
+    unsigned head = *cqHead;
+    if (head == loadAcquire(cqTail)) {
+        return false;
+    }
+    const io_uring_cqe* cqe = &cqes[head & cqMask];
+    out.tag = cqe->user_data;
+    out.result = cqe->res;
+    return true;
+}
+
+void IoRing::advance() {
+    --submitted;
+    if (ringFd == -1) {
+        if (++doneHead == done.size()) {
+            done.clear();
+            doneHead = 0;
+        }
+        return;
+    }
+    storeRelease(cqHead, *cqHead + 1);
+}
+
+// Runs every queued operation with a plain system call, cancelling the
+// rest of a linked run after a short or failed one as io_uring does.
+void IoRing::runFallback() {
+    bool cancel = false;
+    for (const Pending& op : pendingOps) {
+        int result = -ECANCELED;
+        if (!cancel) {
+            ssize_t n;
+            do {
+                if (op.opcode == IORING_OP_READ) {
+                    n = read(op.fd, op.buf, op.len);
+                } else {
+                    n = write(op.fd, op.buf, op.len);
+                }
+            } while (n == -1 && errno == EINTR);
+            result = n == -1 ? -errno : static_cast<int>(n);
+        }
+        done.push_back(Completion{op.tag, result});
+        cancel = op.linked && (cancel || result != static_cast<int>(op.len));
+    }
+    submitted += pendingOps.size();
+    queued -= pendingOps.size();
+    pendingOps.clear();
+
+    uint64_t one = 1;
+    if (evFd != -1 && write(evFd, &one, sizeof(one)) == -1 && errno != EAGAIN) {
+        perror("eventfd write failed");
+    }
+}
@@ -0,0 +1,172 @@
+#ifndef IO_RING_H
+#define IO_RING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <sys/types.h>
+
+class EventLoop;
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/*
+ * IoRing:
+ * Batched asynchronous read()/write() on pipes, FIFOs, sockets and files.
+ * Operations are queued with prepRead()/prepWrite(), handed to the kernel
+ * together by submit(), and their results collected with reap().
+ *
+ * Backed by io_uring when the kernel has it and supports IORING_OP_READ /
+ * IORING_OP_WRITE (checked at runtime with a probe); then a whole batch
+ * costs one io_uring_enter() and completions are read from shared memory
+ * with no system call at all. Otherwise submit() performs the queued
+ * operations with plain read()/write() calls and reap() hands out their
+ * results the same way. In that mode an operation on a blocking
+ * descriptor blocks inside submit().
+ *
+ * Ordering: the fallback runs operations one after the other in queue
+ * order, but io_uring does not. An operation that would block is punted
+ * to a kernel worker, and two of them on the same pipe may run in either
+ * order. Constructed with 'ordered', the ring links every operation to
+ * the one queued right before it when both use the same descriptor
+ * (IOSQE_IO_LINK), so such a run executes in queue order on both
+ * backends. Links only join operations handed over by the same submit();
+ * the automatic submit of a full queue ends a run. A linked operation
+ * that fails or transfers less than 'len' bytes cancels the rest of its
+ * run, which completes with -ECANCELED (the fallback does the same).
+ *
+ * Each operation carries a caller-chosen 64-bit tag that comes back with
+ * its result; nothing is allocated per operation. Buffers must stay valid
+ * until the operation's completion has been reaped.
+ *
+ * eventFd() becomes readable whenever completions are posted, so a ring
+ * can be driven from an EventLoop; attach() watches it and reaps from
+ * the loop's callback.
+ *
+ * Not thread-safe: one thread owns the ring. Once attached, that is the
+ * thread running the loop's callbacks.
+ */
+class IoRing {
+public:
+    // Result of one operation: bytes transferred, or -errno
+    struct Completion {
+        uint64_t tag;
+        int result;
+    };
+
+    // 'entries' is rounded up to a power of two by the kernel; up to twice
+    // that many operations can be in flight.
+    explicit IoRing(unsigned entries = 256, bool ordered = false);
+    ~IoRing();
+
+    IoRing(const IoRing&) = delete;
+    IoRing& operator=(const IoRing&) = delete;
+
+    // io_uring is in use (false: syscall fallback)
+    bool usingUring() const { return ringFd != -1; }
+
+    // Readable (EPOLLIN) when there are completions to reap; -1 if no
+    // eventfd could be set up.
+    int eventFd() const { return evFd; }
+
+    // Resets eventFd() to not readable; call before reap() so completions
+    // posted meanwhile signal it again.
+    void ackEvent();
+
+    // Queue a read/write at the current file position. Returns false if
+    // the ring already holds as many operations as it can complete;
+    // reap() first. A full submission queue is submitted automatically.
+    bool prepRead(int fd, void* buf, unsigned len, uint64_t tag);
+    bool prepWrite(int fd, const void* buf, unsigned len, uint64_t tag);
+
+    // Hands every queued operation to the kernel. Returns the number
+    // submitted, -1 on error.
+    int submit();
+
+    // submit(), then sleeps until at least 'minComplete' operations have
+    // completed. Returns false on error.
+    bool submitAndWait(unsigned minComplete = 1);
+
+    // Calls fn(const Completion&) for up to 'max' finished operations.
+    // Returns the number handed out.
+    template <typename F>
+    size_t reap(F&& fn, size_t max = SIZE_MAX);
+
+    // Submitted or queued and not yet reaped
+    size_t inFlight() const { return queued + submitted; }
+
+    // Watches eventFd() on 'loop'; whenever it fires, acks it and calls
+    // fn(const Completion&) for every finished operation. Queue and submit
+    // further operations from loop callbacks ('fn' included) from then on.
+    // False without an eventfd or if the loop cannot watch it.
+    bool attach(EventLoop& loop, std::function<void(const Completion&)> fn);
+
+    // Stops the loop from watching the ring; done by the destructor too.
+    void detach();
+
+private:
+    struct Pending {
+        uint8_t opcode;
+        int fd;
+        void* buf;
+        unsigned len;
+        uint64_t tag;
+        bool linked;        // the next operation waits for this one
+    };
+
+    bool setupUring(unsigned entries);
+    bool prep(uint8_t opcode, int fd, void* buf, unsigned len, uint64_t tag);
+    bool peek(Completion& out);
+    void advance();
+    int enter(unsigned toSubmit, unsigned minComplete, unsigned flags);
+    void runFallback();
+
+    int ringFd;
+    int evFd;
+    EventLoop* attached;
+    bool ordered;
+    int lastFd;             // descriptor of the last queued operation
+    unsigned lastIndex;     // and its SQ slot
+
+    // io_uring rings (mapped)
+    void* sqMap;
+    size_t sqMapSize;
+    void* cqMap;
+    size_t cqMapSize;
+    io_uring_sqe* sqes;
+    size_t sqesSize;
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned* sqArray;
+    unsigned sqMask;
+    unsigned sqEntries;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    io_uring_cqe* cqes;
+    unsigned cqMask;
+    unsigned cqEntries;
+    unsigned localTail;     // SQ tail including queued, unsubmitted entries
+
+    // Fallback
+    std::vector<Pending> pendingOps;
+    std::vector<Completion> done;
+    size_t doneHead;
+
+    size_t queued;          // prepared, not submitted
+    size_t submitted;       // submitted, not reaped
+};
+
+template <typename F>
+size_t IoRing::reap(F&& fn, size_t max) {
+    size_t handled = 0;
+    Completion c;
+    while (handled < max && peek(c)) {
+        fn(c);
+        advance();
+        ++handled;
+    }
+    return handled;
+}
+
+#endif
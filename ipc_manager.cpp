@@ -2,9 +2,14 @@
 
 #include <unistd.h>
 #include <fcntl.h>
+#include <climits>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <sys/uio.h>
+#include <poll.h>
 #include <cerrno>
+#include <cstdint>
+#include <cstdio>
 #include <cstring>
 #include <iostream>
 #include <vector>
@@ -23,8 +28,7 @@ bool IPCManager::createPipe(Pipe& p) {
 }
 
 bool IPCManager::writeToPipe(const Pipe& p, const std::string& msg) {
-    ssize_t n = write(p.writeFd, msg.c_str(), msg.size());
-    if (n == -1) {
+    if (!writeAll(p.writeFd, msg.data(), msg.size())) {
         perror("write to pipe failed");
         return false;
     }
@@ -32,14 +36,303 @@ bool IPCManager::writeToPipe(const Pipe& p, const std::string& msg) {
 }
 
 std::string IPCManager::readFromPipe(const Pipe& p, size_t maxBytes) {
-    std::vector<char> buf(maxBytes + 1);
+    std::vector<char> buf(maxBytes);
     ssize_t n = read(p.readFd, buf.data(), maxBytes);
     if (n == -1) {
         perror("read from pipe failed");
         return "";
     }
-    buf[n] = '\0';
-    return std::string(buf.data());
+    return std::string(buf.data(), n);
+}
+
+//Framed Messages
+
+// Blocks until a non-blocking descriptor that returned EAGAIN has room.
+static bool waitWritable(int fd) {
+    struct pollfd pfd = {fd, POLLOUT, 0};
+    return poll(&pfd, 1, -1) != -1 || errno == EINTR;
+}
+
+// Writes every iovec in full. Advances 'iov' in place on short writes, so
+// a frame is never left half-sent on the stream.
+static bool writevAll(int fd, struct iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t n = writev(fd, iov, count);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && waitWritable(fd)) {
+                continue;
+            }
+            return false;
+        }
+        size_t done = static_cast<size_t>(n);
+        while (count > 0 && done >= iov->iov_len) {
+            done -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + done;
+            iov->iov_len -= done;
+        }
+    }
+    return true;
+}
+
+bool IPCManager::writeAll(int fd, const void* data, size_t len) {
+    struct iovec iov = {const_cast<void*>(data), len};
+    return writevAll(fd, &iov, 1);
+}
+
+bool IPCManager::writeFrame(int fd, const void* data, size_t len) {
+    if (len > UINT32_MAX) {
+        fprintf(stderr, "frame of %zu bytes is too large\n", len);
+        return false;
+    }
+    uint32_t header = static_cast<uint32_t>(len);
+    struct iovec iov[2] = {
+        {&header, sizeof(header)},
+        {const_cast<void*>(data), len}
+    };
+    if (!writevAll(fd, iov, 2)) {
+        perror("write frame failed");
+        return false;
+    }
+    return true;
+}
+
+static_assert(2 * IPCManager::FRAMES_PER_WRITE <= IOV_MAX,
+              "a frame group must fit in one writev()");
+
+// Fills the iovec array for up to FRAMES_PER_WRITE messages at a time,
+// 'payload(i)' giving the i-th message, and writes each group with one
+// writevAll(). Headers and iovecs live on the stack.
+template <typename Payload>
+static bool writeFrameGroups(int fd, size_t count, Payload payload) {
+    const size_t group = IPCManager::FRAMES_PER_WRITE;
+    uint32_t headers[group];
+    struct iovec iov[2 * group];
+
+    for (size_t first = 0; first < count; first += group) {
+        size_t n = count - first < group ? count - first : group;
+        for (size_t i = 0; i < n; ++i) {
+            struct iovec msg = payload(first + i);
+            if (msg.iov_len > UINT32_MAX) {
+                fprintf(stderr, "frame of %zu bytes is too large\n", msg.iov_len);
+                return false;
+            }
+            headers[i] = static_cast<uint32_t>(msg.iov_len);
+            iov[2 * i].iov_base = &headers[i];
+            iov[2 * i].iov_len = sizeof(uint32_t);
+            iov[2 * i + 1] = msg;
+        }
+        if (!writevAll(fd, iov, static_cast<int>(2 * n))) {
+            perror("write frames failed");
+            return false;
+        }
+    }
+    return true;
+}
+
+bool IPCManager::writeFrames(int fd, const struct iovec* msgs, size_t count) {
+    return writeFrameGroups(fd, count, [msgs](size_t i) { return msgs[i]; });
+}
+
+bool IPCManager::writeFrames(int fd, const std::vector<std::string>& msgs) {
+    return writeFrameGroups(fd, msgs.size(), [&msgs](size_t i) {
+        struct iovec iov = {const_cast<char*>(msgs[i].data()), msgs[i].size()};
+        return iov;
+    });
+}
+
+bool IPCManager::sendFrames(const Pipe& p, const std::vector<std::string>& msgs) {
+    return writeFrames(p.writeFd, msgs);
+}
+
+size_t IPCManager::setPipeSize(int fd, size_t bytes) {
+    int size = fcntl(fd, F_SETPIPE_SZ, static_cast<int>(bytes));
+    if (size == -1) {
+        perror("F_SETPIPE_SZ failed");
+        return 0;
+    }
+    return static_cast<size_t>(size);
+}
+
+bool IPCManager::sendFrame(const Pipe& p, const void* data, size_t len) {
+    return writeFrame(p.writeFd, data, len);
+}
+
+bool IPCManager::sendFrame(const Pipe& p, const std::string& msg) {
+    return writeFrame(p.writeFd, msg.data(), msg.size());
+}
+
+//Bulk Transfer
+
+// Largest chunk handed to splice()/vmsplice() per call
+static const size_t SPLICE_CHUNK = 1 << 20;
+static const size_t COPY_BUFFER = 256 * 1024;
+
+static bool isPipe(int fd) {
+    struct stat st;
+    return fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+}
+
+// The kernel or file system cannot splice this pair of descriptors.
+static bool spliceUnsupported(int err) {
+    return err == EINVAL || err == ENOSYS || err == EOPNOTSUPP;
+}
+
+// read()/write() loop for descriptors that cannot be spliced
+static ssize_t copyLoop(int fromFd, int toFd, size_t len) {
+    std::vector<char> buf(len < COPY_BUFFER ? len : COPY_BUFFER);
+    size_t moved = 0;
+    while (moved < len) {
+        size_t want = len - moved < buf.size() ? len - moved : buf.size();
+        ssize_t n = read(fromFd, buf.data(), want);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("read for transfer failed");
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        if (!IPCManager::writeAll(toFd, buf.data(), n)) {
+            perror("write for transfer failed");
+            return -1;
+        }
+        moved += n;
+    }
+    return static_cast<ssize_t>(moved);
+}
+
+// One splice() call, retried on EINTR and on a full non-blocking output.
+// EAGAIN is passed on when it is the input that has nothing to give.
+static ssize_t spliceOnce(int fromFd, int toFd, size_t len) {
+    while (true) {
+        ssize_t n = splice(fromFd, nullptr, toFd, nullptr, len, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n == -1 && errno == EAGAIN) {
+            struct pollfd pfd = {toFd, POLLOUT, 0};
+            if (poll(&pfd, 1, 0) == 0 && waitWritable(toFd)) {
+                continue;
+            }
+            errno = EAGAIN;
+        }
+        return n;
+    }
+}
+
+// splice() loop where one side is a pipe. If the pair turns out not to be
+// spliceable the rest is copied instead.
+static ssize_t spliceLoop(int fromFd, int toFd, size_t len) {
+    size_t moved = 0;
+    while (moved < len) {
+        ssize_t n = spliceOnce(fromFd, toFd, len - moved < SPLICE_CHUNK ? len - moved : SPLICE_CHUNK);
+        if (n == -1 && errno == EAGAIN) {
+            break;
+        }
+        if (n == -1) {
+            if (!spliceUnsupported(errno)) {
+                perror("splice failed");
+                return -1;
+            }
+            ssize_t rest = copyLoop(fromFd, toFd, len - moved);
+            return rest == -1 ? -1 : static_cast<ssize_t>(moved) + rest;
+        }
+        if (n == 0) {
+            break;
+        }
+        moved += n;
+    }
+    return static_cast<ssize_t>(moved);
+}
+
+ssize_t IPCManager::transfer(int fromFd, int toFd, size_t len) {
+    if (isPipe(fromFd) || isPipe(toFd)) {
+        return spliceLoop(fromFd, toFd, len);
+    }
+
+    // Neither side is a pipe: splice in and out through one of our own,
+    // at most one pipe-full per round.
+    Pipe mid;
+    if (!createPipe(mid)) {
+        return copyLoop(fromFd, toFd, len);
+    }
+    size_t moved = 0;
+    ssize_t result = 0;
+    while (moved < len) {
+        ssize_t in = spliceOnce(fromFd, mid.writeFd, len - moved < SPLICE_CHUNK ? len - moved : SPLICE_CHUNK);
+        if (in == -1 && errno == EAGAIN) {
+            break;
+        }
+        if (in == -1) {
+            if (!spliceUnsupported(errno)) {
+                perror("splice failed");
+                result = -1;
+                break;
+            }
+            ssize_t rest = copyLoop(fromFd, toFd, len - moved);
+            result = rest == -1 ? -1 : static_cast<ssize_t>(moved) + rest;
+            break;
+        }
+        if (in == 0) {
+            break;
+        }
+        if (spliceLoop(mid.readFd, toFd, in) != in) {
+            result = -1;
+            break;
+        }
+        moved += in;
+        result = static_cast<ssize_t>(moved);
+    }
+    close(mid.readFd);
+    close(mid.writeFd);
+    return result;
+}
+
+bool IPCManager::sendPages(const Pipe& p, const void* data, size_t len) {
+    const char* pos = static_cast<const char*>(data);
+    size_t left = len;
+    while (left > 0) {
+        struct iovec iov = {const_cast<char*>(pos), left < SPLICE_CHUNK ? left : SPLICE_CHUNK};
+        ssize_t n = vmsplice(p.writeFd, &iov, 1, 0);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN && waitWritable(p.writeFd)) {
+                continue;
+            }
+            if (spliceUnsupported(errno)) {
+                return writeAll(p.writeFd, pos, left);
+            }
+            perror("vmsplice failed");
+            return false;
+        }
+        pos += n;
+        left -= n;
+    }
+    return true;
+}
+
+ssize_t IPCManager::teePipe(const Pipe& from, const Pipe& to, size_t len) {
+    while (true) {
+        ssize_t n = tee(from.readFd, to.writeFd, len < SPLICE_CHUNK ? len : SPLICE_CHUNK, 0);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n == -1) {
+            perror("tee failed");
+        }
+        return n;
+    }
 }
 
 //Named Pipe (FIFO)
@@ -61,8 +354,7 @@ bool IPCManager::writeToFIFO(const std::string& path, const std::string& msg) {
         perror("open FIFO for write failed");
         return false;
     }
-    ssize_t n = write(fd, msg.c_str(), msg.size());
-    if (n == -1) {
+    if (!writeAll(fd, msg.data(), msg.size())) {
         perror("write to FIFO failed");
         close(fd);
         return false;
@@ -78,16 +370,24 @@ std::string IPCManager::readFromFIFO(const std::string& path, size_t maxBytes) {
         return "";
     }
 
-    std::vector<char> buf(maxBytes + 1);
+    std::vector<char> buf(maxBytes);
     ssize_t n = read(fd, buf.data(), maxBytes);
     if (n == -1) {
         perror("read from FIFO failed");
         close(fd);
         return "";
     }
-    buf[n] = '\0';
     close(fd);
-    return std::string(buf.data());
+    return std::string(buf.data(), n);
+}
+
+int IPCManager::openFIFO(const std::string& path, int flags) {
+    int fd = open(path.c_str(), flags | O_CLOEXEC);
+    if (fd == -1) {
+        perror("open FIFO failed");
+        return -1;
+    }
+    return fd;
 }
 
 //Shared Memory
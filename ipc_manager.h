@@ -1,8 +1,12 @@
 #ifndef IPC_MANAGER_H
 #define IPC_MANAGER_H
 
+#include <cstdint>
 #include <string>
+#include <vector>
 #include <sys/stat.h>   // Needed for mode_t (permissions for FIFO creation)
+#include <sys/types.h>  // ssize_t
+#include <sys/uio.h>    // struct iovec for batched frames
 
 /*
  * Pipe struct:
@@ -44,6 +48,67 @@ public:
     static std::string readFromPipe(const Pipe& p, size_t maxBytes = 1024);
 
 
+    // -------------------------------
+    // Framed Messages (pipes and FIFOs)
+    // -------------------------------
+    // Each message goes out as a 4-byte length followed by the payload,
+    // so message boundaries survive short reads and payloads may contain
+    // any bytes. Read them back with a FrameReader (frame_reader.h).
+
+    // Writes all 'len' bytes, retrying on short writes and EINTR. On an
+    // O_NONBLOCK descriptor it waits for room rather than failing halfway.
+    static bool writeAll(int fd, const void* data, size_t len);
+
+    // Writes one frame with a single writev() when the pipe has room.
+    // Frames up to PIPE_BUF - 4 bytes are atomic with several writers.
+    static bool writeFrame(int fd, const void* data, size_t len);
+
+    // writeFrame() on the pipe's write end
+    static bool sendFrame(const Pipe& p, const void* data, size_t len);
+    static bool sendFrame(const Pipe& p, const std::string& msg);
+
+    // Writes 'count' messages as consecutive frames with one writev() per
+    // FRAMES_PER_WRITE messages, without copying the payloads.
+    static bool writeFrames(int fd, const struct iovec* msgs, size_t count);
+    static bool writeFrames(int fd, const std::vector<std::string>& msgs);
+
+    // writeFrames() on the pipe's write end
+    static bool sendFrames(const Pipe& p, const std::vector<std::string>& msgs);
+
+    // Messages per writev(): two iovecs each, bounded by IOV_MAX
+    static const size_t FRAMES_PER_WRITE = 512;
+
+    // Resizes the kernel buffer of a pipe or FIFO (F_SETPIPE_SZ) so a large
+    // batch is not split into many writes. Returns the new size, or 0.
+    static size_t setPipeSize(int fd, size_t bytes);
+
+
+    // -------------------------------
+    // Bulk Transfer (splice / vmsplice / tee)
+    // -------------------------------
+    // These move data through the kernel's pipe buffers without copying
+    // it through user space. Where the kernel or the file system cannot
+    // splice, they fall back to plain read()/write() copies.
+
+    // Moves up to 'len' bytes (SIZE_MAX: until end of input) from one
+    // descriptor to another; either may be a pipe, file or socket. With
+    // neither side a pipe the data goes through an internal pipe. Stops
+    // early if a non-blocking input runs dry. Returns the number of bytes
+    // moved, or -1 on error.
+    static ssize_t transfer(int fromFd, int toFd, size_t len = SIZE_MAX);
+
+    // Maps the pages of 'data' into the pipe instead of copying them. The
+    // pipe then refers to the caller's memory: do not modify or free it
+    // until the reader has consumed the data.
+    static bool sendPages(const Pipe& p, const void* data, size_t len);
+
+    // Duplicates up to 'len' bytes waiting in 'from' into 'to' without
+    // consuming them, e.g. to fan one stream out to two stages. Both must
+    // be pipes; there is no copying fallback. Returns the bytes
+    // duplicated (0 if 'from' is empty and at end of input), or -1.
+    static ssize_t teePipe(const Pipe& from, const Pipe& to, size_t len = SIZE_MAX);
+
+
     // -------------------------------
     // Named Pipe (FIFO) Methods
     // -------------------------------
@@ -53,11 +118,17 @@ public:
     static bool createFIFO(const std::string& path, mode_t mode = 0666);
 
     // Writes 'msg' into the FIFO located at 'path'.
+    // Opens and closes the FIFO on every call (so does readFromFIFO);
+    // use a FifoChannel (fifo_channel.h) for a stream of messages.
     static bool writeToFIFO(const std::string& path, const std::string& msg);
 
     // Reads from the FIFO file up to 'maxBytes'.
     static std::string readFromFIFO(const std::string& path, size_t maxBytes = 1024);
 
+    // Opens the FIFO once for framed streaming; 'flags' is O_RDONLY or
+    // O_WRONLY, optionally with O_NONBLOCK. Returns the descriptor or -1.
+    static int openFIFO(const std::string& path, int flags);
+
 
     // -------------------------------
     // Shared Memory Methods
@@ -0,0 +1,86 @@
+#include "latency_histogram.h"
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+LatencyHistogram::LatencyHistogram(const LatencyHistogram& other) {
+    reset();
+    merge(other);
+}
+
+LatencyHistogram& LatencyHistogram::operator=(const LatencyHistogram& other) {
+    if (this != &other) {
+        reset();
+        merge(other);
+    }
+    return *this;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        uint64_t n = other.counts[i].load(std::memory_order_relaxed);
+        if (n) {
+            bump(counts[i], n);
+        }
+    }
+    bump(total, other.total.load(std::memory_order_relaxed));
+    bump(sum, other.sum.load(std::memory_order_relaxed));
+    uint64_t otherMax = other.maxValue.load(std::memory_order_relaxed);
+    if (otherMax > maxValue.load(std::memory_order_relaxed)) {
+        maxValue.store(otherMax, std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::reset() {
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        counts[i].store(0, std::memory_order_relaxed);
+    }
+    total.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    maxValue.store(0, std::memory_order_relaxed);
+}
+
+double LatencyHistogram::mean() const {
+    uint64_t n = count();
+    return n ? static_cast<double>(sum.load(std::memory_order_relaxed)) / n : 0.0;
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const {
+    // Sum the buckets instead of trusting 'total': a concurrent record()
+    // may have bumped one but not yet the other.
+    uint64_t n = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        n += counts[i].load(std::memory_order_relaxed);
+    }
+    if (n == 0) {
+        return 0;
+    }
+    if (fraction < 0.0) {
+        fraction = 0.0;
+    }
+    uint64_t rank = static_cast<uint64_t>(fraction * n + 0.5);
+    rank = rank < 1 ? 1 : (rank > n ? n : rank);
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        seen += counts[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            // Never report more than was actually recorded
+            uint64_t bound = upperBound(i);
+            uint64_t top = max();
+            return bound < top ? bound : top;
+        }
+    }
+    return max();
+}
+
+uint64_t LatencyHistogram::upperBound(size_t bucket) {
+    if (bucket < 2 * SUB_BUCKETS) {
+        return bucket;
+    }
+    unsigned shift = static_cast<unsigned>(bucket / SUB_BUCKETS) - 1;
+    uint64_t sub = bucket % SUB_BUCKETS;
+    uint64_t low = (SUB_BUCKETS + sub) << shift;
+    return low + ((uint64_t(1) << shift) - 1);
+}
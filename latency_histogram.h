@@ -0,0 +1,76 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * LatencyHistogram:
+ * Log-linear histogram of nanosecond values in the style of HdrHistogram.
+ * Values below 2*SUB_BUCKETS are exact; above that every power of two is
+ * split into SUB_BUCKETS linear buckets, so any recorded value is reported
+ * within ~6% of its true value, from nanoseconds up to centuries, in a
+ * fixed 8 KB with no allocation.
+ *
+ * record() is meant for a single writer (the owning worker) and costs a
+ * few relaxed loads and stores. Copying and the query functions may run on
+ * any thread at the same time; they see a slightly stale but consistent
+ * enough view for monitoring.
+ */
+class LatencyHistogram {
+public:
+    static const unsigned SUB_BUCKET_BITS = 4;
+    static const size_t SUB_BUCKETS = size_t(1) << SUB_BUCKET_BITS;
+    static const size_t NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    LatencyHistogram();
+    LatencyHistogram(const LatencyHistogram& other);
+    LatencyHistogram& operator=(const LatencyHistogram& other);
+
+    // Single writer only
+    void record(uint64_t value) {
+        bump(counts[bucketOf(value)], 1);
+        bump(total, 1);
+        bump(sum, value);
+        if (value > maxValue.load(std::memory_order_relaxed)) {
+            maxValue.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    // Adds other's counts into this one; this must not be written concurrently.
+    void merge(const LatencyHistogram& other);
+    void reset();
+
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    uint64_t max() const { return maxValue.load(std::memory_order_relaxed); }
+    double mean() const;
+
+    // Smallest bucket bound at or above the given fraction (0.0 - 1.0) of
+    // the recorded values, e.g. percentile(0.99); 0 if empty.
+    uint64_t percentile(double fraction) const;
+
+private:
+    static size_t bucketOf(uint64_t value) {
+        if (value < 2 * SUB_BUCKETS) {
+            return static_cast<size_t>(value);
+        }
+        unsigned msb = 63 - __builtin_clzll(value);
+        unsigned shift = msb - SUB_BUCKET_BITS;
+        return (shift + 1) * SUB_BUCKETS + ((value >> shift) & (SUB_BUCKETS - 1));
+    }
+
+    // Largest value that lands in 'bucket'
+    static uint64_t upperBound(size_t bucket);
+
+    static void bump(std::atomic<uint64_t>& counter, uint64_t n) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> counts[NUM_BUCKETS];
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> maxValue;
+};
+
+#endif
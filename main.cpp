@@ -1,15 +1,26 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <atomic>
+#include <chrono>
 #include <cstring>
+#include <memory>
+#include <mutex>
 #include <unistd.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 
 #include "process_manager.h"
 #include "thread_manager.h"
 #include "thread_pool.h"
 #include "ipc_manager.h"
+#include "frame_reader.h"
+#include "shm_ring_channel.h"
+#include "shared_segment.h"
+#include "shm_allocator.h"
+#include "event_loop.h"
+#include "process_pool.h"
 
 //
 // Example thread function used by ThreadManager.
@@ -33,14 +44,19 @@ int main() {
 
         ProcessManager pm;
 
+        // Reap children as they exit instead of polling with waitpid(),
+        // and sample CPU / memory / I/O of running ones from /proc.
+        pm.startReaper();
+        pm.startSampler(std::chrono::milliseconds(100));
+
         // Create a new child process that runs "ls -l".
-        pm.createProcess({"/bin/ls", "-l"});
+        pm.createProcess({"/bin/ls", "-l"}, SpawnOptions(), [](const ProcessInfo& info) {
+            std::cout << "[ProcessManager] " << info.command << " (PID " << info.pid
+                      << ") exited with " << WEXITSTATUS(info.exitStatus) << "\n";
+        });
 
         sleep(1);  // Give the child time to complete.
 
-        // Check for terminated processes and update their state.
-        pm.updateProcessStates();
-
         // Print a table showing the PID, command, and state of the child.
         pm.printProcessTable();
     }
@@ -95,6 +111,53 @@ int main() {
     }
 
 
+    // ----------------------------------------------------------
+    // 2b) IPC — FRAMED PIPE DEMO
+    // Child sends length-prefixed messages back to back; the parent
+    // splits them apart again, embedded NUL bytes included.
+    // ----------------------------------------------------------
+    {
+        std::cout << "\n>>> Demo: IPCManager - Framed pipe messages\n";
+
+        Pipe p;
+        if (!IPCManager::createPipe(p)) {
+            std::cerr << "Failed to create unnamed pipe\n";
+        } else {
+            pid_t pid = fork();
+
+            if (pid < 0) {
+                perror("fork failed");
+
+            } else if (pid == 0) {
+                // CHILD PROCESS: three frames, one of them binary.
+                close(p.readFd);
+                IPCManager::sendFrame(p, "first frame");
+                IPCManager::sendFrame(p, std::string("with\0nul", 8));
+                IPCManager::sendFrame(p, "last frame");
+                close(p.writeFd);
+                _exit(0);
+
+            } else {
+                // PARENT PROCESS: read frames until the child closes its end.
+                close(p.writeFd);
+
+                FrameReader reader(p.readFd);
+                std::string msg;
+                while (reader.receive(msg) == FrameReader::Status::OK) {
+                    std::cout << "[Parent] Frame of " << msg.size() << " bytes: ";
+                    for (char c : msg) {
+                        std::cout << (c == '\0' ? "\\0" : std::string(1, c));
+                    }
+                    std::cout << "\n";
+                }
+
+                close(p.readFd);
+                waitpid(pid, nullptr, 0);
+            }
+        }
+    }
+
+
     // ----------------------------------------------------------
     // 3) IPC — SHARED MEMORY DEMO
     // Demonstrates two processes sharing the same memory region.
@@ -168,6 +231,116 @@ int main() {
     }
 
 
+    // ----------------------------------------------------------
+    // 3b) IPC — SHARED MEMORY RING CHANNEL DEMO
+    // Child writes framed messages straight into the segment;
+    // parent reads them in place, no system calls per message.
+    // ----------------------------------------------------------
+    {
+        std::cout << "\n>>> Demo: ShmRingChannel\n";
+
+        const std::string ringName = "/my_ring_example";
+        ShmRingChannel channel;
+
+        if (!channel.create(ringName, 4096)) {
+            std::cerr << "Failed to create ring channel\n";
+        } else {
+            pid_t pid = fork();
+
+            if (pid < 0) {
+                perror("fork failed");
+
+            } else if (pid == 0) {
+                // CHILD PROCESS: open the channel by name and send 3 messages.
+                ShmRingChannel producer;
+                if (!producer.open(ringName)) {
+                    _exit(1);
+                }
+                for (int i = 1; i <= 3; ++i) {
+                    std::string msg = "ring message " + std::to_string(i);
+                    ShmRingChannel::Reservation r;
+                    while (!producer.reserve(msg.size(), r)) {
+                        producer.waitForSpace(msg.size());
+                    }
+                    std::memcpy(r.data, msg.data(), msg.size());
+                    producer.commit(r, msg.size());
+                }
+                _exit(0);
+
+            } else {
+                // PARENT PROCESS: sleep on the channel until all 3 messages are in.
+                int received = 0;
+                while (received < 3) {
+                    channel.waitForData();
+                    received += channel.drain([](const char* data, size_t len) {
+                        std::cout << "[Parent] Ring received: " << std::string(data, len) << "\n";
+                    });
+                }
+                waitpid(pid, nullptr, 0);
+                IPCManager::unlinkSharedMemory(ringName);
+            }
+        }
+    }
+
+
+    // ----------------------------------------------------------
+    // 3c) IPC — SHARED ALLOCATOR DEMO
+    // Child builds a linked list of variable-size records inside the
+    // segment; parent walks it through offset pointers.
+    // ----------------------------------------------------------
+    {
+        std::cout << "\n>>> Demo: ShmAllocator\n";
+
+        // Stored in the segment; OffsetPtr works wherever each process mapped it.
+        struct Record {
+            OffsetPtr<Record> next;
+            uint32_t length;
+            char text[1];
+        };
+
+        SharedSegment segment;
+        ShmAllocator alloc;
+        if (!segment.createAnonymous(1 << 20) || !alloc.format(segment.data(), segment.size())) {
+            std::cerr << "Failed to set up shared allocator\n";
+        } else {
+            pid_t pid = fork();
+
+            if (pid < 0) {
+                perror("fork failed");
+
+            } else if (pid == 0) {
+                // CHILD PROCESS: allocate one record per word, newest first.
+                const char* words[] = {"records", "sized", "variably", "shares", "child"};
+                Record* head = nullptr;
+                for (const char* w : words) {
+                    size_t len = strlen(w);
+                    uint64_t off = alloc.allocate(sizeof(Record) + len);
+                    Record* r = alloc.get<Record>(off);
+                    r->next = head;
+                    r->length = static_cast<uint32_t>(len);
+                    memcpy(r->text, w, len);
+                    head = r;
+                }
+                alloc.setRoot(alloc.offsetOf(head));
+                _exit(0);
+
+            } else {
+                // PARENT PROCESS: walk the list, then free it.
+                waitpid(pid, nullptr, 0);
+                std::cout << "[Parent] Records:";
+                Record* r = alloc.get<Record>(alloc.root());
+                while (r) {
+                    Record* next = r->next.get();
+                    std::cout << " " << std::string(r->text, r->length);
+                    alloc.deallocate(alloc.offsetOf(r));
+                    r = next;
+                }
+                std::cout << "\n[Parent] Allocator used " << alloc.used() << " bytes\n";
+            }
+        }
+    }
+
+
     // ----------------------------------------------------------
     // 4) THREAD MANAGER DEMO
     // Demonstrates creating and joining pthreads using ThreadManager.
@@ -205,11 +378,124 @@ int main() {
             });
         }
 
+        // submit() forwards arguments and returns a future for the result.
+        auto sum = pool.submit([](int a, int b) { return a + b; }, 20, 22);
+        int result = sum.get();
+        std::cout << "[ThreadPool] Future result: " << result << "\n";
+
+        // parallelFor() splits an index range into chunks across the workers.
+        std::vector<long> squares(1000);
+        pool.parallelFor(0, squares.size(), 64, [&squares](size_t i) {
+            squares[i] = static_cast<long>(i * i);
+        });
+        std::cout << "[ThreadPool] parallelFor: squares[999] = " << squares[999] << "\n";
+
         // Gracefully shut down after all tasks complete.
         pool.shutdown();
         std::cout << "ThreadPool shutdown completed.\n";
     }
 
+    // ----------------------------------------------------------
+    // 6) EVENT LOOP DEMO
+    // One loop thread watches every worker's pipe and exit; the
+    // callbacks themselves run on a thread pool.
+    // ----------------------------------------------------------
+    {
+        std::cout << "\n>>> Demo: EventLoop (3 children, callbacks on a pool)\n";
+
+        ThreadPool pool(2);
+        EventLoop loop(&pool);
+        std::mutex outMtx;
+        std::atomic<int> pending(6);   // 3 pipes to drain + 3 exits
+
+        auto finished = [&]() {
+            if (--pending == 0) {
+                loop.stop();
+            }
+        };
+
+        for (int i = 0; i < 3; ++i) {
+            Pipe p;
+            if (!IPCManager::createPipe(p)) {
+                continue;
+            }
+            pid_t pid = fork();
+            if (pid < 0) {
+                perror("fork failed");
+                continue;
+            }
+            if (pid == 0) {
+                close(p.readFd);
+                usleep((3 - i) * 50 * 1000);   // finish in reverse order
+                IPCManager::sendFrame(p, "worker " + std::to_string(i) + " done");
+                _exit(i);
+            }
+            close(p.writeFd);
+
+            auto reader = std::make_shared<FrameReader>(p.readFd);
+            loop.watch(p.readFd, EPOLLIN, [&, reader](int fd, uint32_t) {
+                std::string msg;
+                FrameReader::Status s = reader->receive(msg);
+                if (s == FrameReader::Status::OK) {
+                    std::lock_guard<std::mutex> lock(outMtx);
+                    std::cout << "[EventLoop] Pipe " << fd << ": " << msg << "\n";
+                } else {
+                    loop.unwatch(fd);
+                    close(fd);
+                    finished();
+                }
+            });
+            loop.watchChild(pid, [&](pid_t child, int status) {
+                {
+                    std::lock_guard<std::mutex> lock(outMtx);
+                    std::cout << "[EventLoop] Child " << child << " exited with "
+                              << WEXITSTATUS(status) << "\n";
+                }
+                finished();
+            });
+        }
+
+        loop.run();
+        pool.shutdown();
+    }
+
+
+    // ----------------------------------------------------------
+    // 7) PROCESS POOL DEMO
+    // Requests go to pre-forked worker processes; a crashing worker
+    // fails only its own request and is replaced.
+    // ----------------------------------------------------------
+    {
+        std::cout << "\n>>> Demo: ProcessPool (2 workers from a zygote)\n";
+
+        ProcessPoolConfig config;
+        config.numWorkers = 2;
+        config.zygote = true;
+        ProcessPool pool(config, [](const std::string& request) -> std::string {
+            if (request == "crash") {
+                _exit(3);
+            }
+            return "worker " + std::to_string(getpid()) + " handled '" + request + "'";
+        });
+
+        std::vector<std::future<std::string>> replies;
+        for (const char* request : {"alpha", "beta", "crash", "gamma"}) {
+            replies.push_back(pool.submit(request));
+        }
+        for (auto& reply : replies) {
+            try {
+                std::string text = reply.get();
+                std::cout << "[ProcessPool] " << text << "\n";
+            } catch (const std::exception& e) {
+                std::cout << "[ProcessPool] Request failed: " << e.what() << "\n";
+            }
+        }
+        std::cout << "[ProcessPool] Live workers: " << pool.size()
+                  << ", respawned: " << pool.respawns() << "\n";
+        pool.shutdown();
+    }
+
+
     std::cout << "\n===== Demo complete =====\n";
     return 0;
 }
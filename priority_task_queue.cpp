@@ -0,0 +1,96 @@
+#include "priority_task_queue.h"
+#include <algorithm>
+
+PriorityTaskQueue::PriorityTaskQueue(Clock::duration agingInterval, Clock::duration deadlineSlack)
+    : count(0), agingInterval(agingInterval), deadlineSlack(deadlineSlack) {}
+
+void PriorityTaskQueue::push(Task&& task, const TaskOptions& options, Clock::time_point now) {
+    if (options.hasDeadline()) {
+        DeadlineEntry entry;
+        entry.task = std::move(task);
+        entry.enqueued = now;
+        entry.deadline = options.deadline;
+        entry.priority = options.priority;
+        deadlines.push_back(std::move(entry));
+        std::push_heap(deadlines.begin(), deadlines.end(), &PriorityTaskQueue::laterDeadline);
+    } else {
+        Entry entry;
+        entry.task = std::move(task);
+        entry.enqueued = now;
+        classes[static_cast<int>(options.priority)].push(std::move(entry));
+    }
+    ++count;
+}
+
+bool PriorityTaskQueue::pop(Task& out, Clock::time_point now, Clock::time_point* enqueued) {
+    if (count == 0) {
+        return false;
+    }
+
+    // Deadline about to be missed (or already missed): run it first.
+    // The slack goes on 'now'; taken off time_point::min() it would wrap.
+    if (!deadlines.empty() && deadlines.front().deadline <= now + deadlineSlack) {
+        popDeadline(out, enqueued);
+        return true;
+    }
+
+    // Otherwise compare the head of every class, and the earliest deadline
+    // task by its own class, after aging.
+    // Ties go to whichever task has waited longest.
+    int best = -1;
+    long bestRank = 0;
+    Clock::time_point bestEnqueued;
+    for (int c = 0; c < NUM_CLASSES; ++c) {
+        if (classes[c].empty()) {
+            continue;
+        }
+        const Entry& head = classes[c].front();
+        long rank = effectiveRank(static_cast<TaskPriority>(c), head.enqueued, now);
+        if (best < 0 || rank < bestRank || (rank == bestRank && head.enqueued < bestEnqueued)) {
+            best = c;
+            bestRank = rank;
+            bestEnqueued = head.enqueued;
+        }
+    }
+
+    if (!deadlines.empty()) {
+        const DeadlineEntry& top = deadlines.front();
+        long rank = effectiveRank(top.priority, top.enqueued, now);
+        if (best < 0 || rank < bestRank || (rank == bestRank && top.enqueued <= bestEnqueued)) {
+            popDeadline(out, enqueued);
+            return true;
+        }
+    }
+
+    out = std::move(classes[best].front().task);
+    if (enqueued) {
+        *enqueued = classes[best].front().enqueued;
+    }
+    classes[best].pop();
+    --count;
+    return true;
+}
+
+long PriorityTaskQueue::effectiveRank(TaskPriority priority, Clock::time_point enqueued,
+                                      Clock::time_point now) const {
+    long rank = static_cast<long>(priority);
+    if (agingInterval.count() > 0 && now > enqueued) {
+        rank -= static_cast<long>((now - enqueued) / agingInterval);
+    }
+    return rank;
+}
+
+// Heap comparator: the root is the earliest deadline.
+bool PriorityTaskQueue::laterDeadline(const DeadlineEntry& a, const DeadlineEntry& b) {
+    return a.deadline > b.deadline;
+}
+
+void PriorityTaskQueue::popDeadline(Task& out, Clock::time_point* enqueued) {
+    std::pop_heap(deadlines.begin(), deadlines.end(), &PriorityTaskQueue::laterDeadline);
+    out = std::move(deadlines.back().task);
+    if (enqueued) {
+        *enqueued = deadlines.back().enqueued;
+    }
+    deadlines.pop_back();
+    --count;
+}
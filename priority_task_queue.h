@@ -0,0 +1,83 @@
+#ifndef PRIORITY_TASK_QUEUE_H
+#define PRIORITY_TASK_QUEUE_H
+
+#include <chrono>
+#include <vector>
+
+#include "task.h"
+
+enum class TaskPriority {
+    HIGH,
+    NORMAL,
+    LOW
+};
+
+struct TaskOptions {
+    TaskPriority priority = TaskPriority::NORMAL;
+
+    // Optional; time_point::max() means no deadline
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+
+    // NUMA node (kernel numbering) whose workers should run the task;
+    // -1 means the submitting thread's node. Ignored unless the pool is
+    // NUMA-aware.
+    int numaNode = -1;
+
+    bool hasDeadline() const { return deadline != std::chrono::steady_clock::time_point::max(); }
+};
+
+/*
+ * PriorityTaskQueue:
+ * One FIFO per priority class plus an earliest-deadline-first heap for
+ * tasks that carry a deadline. pop() picks:
+ *   1) the earliest deadline, once it is within 'deadlineSlack' of now
+ *   2) otherwise the candidate with the best effective class, where every
+ *      'agingInterval' spent waiting promotes a task by one class, so
+ *      LOW work cannot be starved by a steady stream of HIGH work; ties go
+ *      to the task that has waited longest
+ * Not thread-safe; ThreadPool guards it with its node mutex.
+ */
+class PriorityTaskQueue {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    PriorityTaskQueue(Clock::duration agingInterval, Clock::duration deadlineSlack);
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+
+    // HIGH-class tasks plus tasks with a deadline
+    size_t urgentSize() const { return classes[0].size() + deadlines.size(); }
+
+    void push(Task&& task, const TaskOptions& options, Clock::time_point now);
+    // 'enqueued', if given, receives the time the task was pushed
+    bool pop(Task& out, Clock::time_point now, Clock::time_point* enqueued = nullptr);
+
+private:
+    static const int NUM_CLASSES = 3;
+
+    struct Entry {
+        Task task;
+        Clock::time_point enqueued;
+    };
+
+    struct DeadlineEntry {
+        Task task;
+        Clock::time_point enqueued;
+        Clock::time_point deadline;
+        TaskPriority priority;
+    };
+
+    static bool laterDeadline(const DeadlineEntry& a, const DeadlineEntry& b);
+    long effectiveRank(TaskPriority priority, Clock::time_point enqueued, Clock::time_point now) const;
+    void popDeadline(Task& out, Clock::time_point* enqueued);
+
+    FifoRing<Entry> classes[NUM_CLASSES];
+    std::vector<DeadlineEntry> deadlines;   // min-heap on deadline
+    size_t count;
+
+    Clock::duration agingInterval;
+    Clock::duration deadlineSlack;
+};
+
+#endif
@@ -1,13 +1,80 @@
 #include "process_manager.h"
+#include "event_loop.h"
 #include <iostream>
 #include <unistd.h>
 #include <sys/wait.h>
 #include <signal.h>
+#include <spawn.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/resource.h>
 
-ProcessManager::ProcessManager() {}
+ProcessManager::ProcessManager(size_t historySize)
+    : table(historySize), samplePass(0), clockTicks(sysconf(_SC_CLK_TCK)),
+      pageSize(sysconf(_SC_PAGESIZE)), samplerStopping(false) {}
+
+ProcessManager::~ProcessManager() {
+    stopSampler();
+    stopReaper();
+    for (auto& entry : procFiles) {
+        closeProcFiles(entry.second);
+    }
+}
 
 // Create a new process
-pid_t ProcessManager::createProcess(const std::vector<std::string>& args) {
+pid_t ProcessManager::createProcess(const std::vector<std::string>& args, const SpawnOptions& options,
+                                    ExitCallback onExit) {
+    if (args.empty()) {
+        std::cerr << "createProcess: no command given" << std::endl;
+        return -1;
+    }
+
+    // Convert args to char** up front; the vfork child must not allocate.
+    std::vector<char*> execArgs;
+    for (const std::string &arg : args)
+        execArgs.push_back((char*)arg.c_str());
+    execArgs.push_back(nullptr);
+
+    pid_t pid = -1;
+    switch (options.method) {
+        case SpawnMethod::FORK_EXEC: pid = forkExec(execArgs.data(), options); break;
+        case SpawnMethod::VFORK: pid = vforkExec(execArgs.data(), options); break;
+        case SpawnMethod::AUTO:
+        case SpawnMethod::POSIX_SPAWN: pid = posixSpawn(execArgs.data(), options); break;
+    }
+    if (pid < 0) {
+        return -1;
+    }
+
+    // Parent process
+    std::lock_guard<std::mutex> lock(mtx);
+    table.insert(pid, args[0]);
+    if (onExit) {
+        callbacks[pid] = std::move(onExit);
+    }
+    if (reaper) {
+        watchExit(pid);
+    }
+
+    return pid;
+}
+
+// Runs in the child between fork/vfork and exec: async-signal-safe calls only.
+static void prepareChild(const SpawnOptions& options) {
+    if (options.stdinFd != -1) dup2(options.stdinFd, STDIN_FILENO);
+    if (options.stdoutFd != -1) dup2(options.stdoutFd, STDOUT_FILENO);
+    if (options.stderrFd != -1) dup2(options.stderrFd, STDERR_FILENO);
+    if (options.newProcessGroup) setpgid(0, 0);
+
+    sigset_t none;
+    sigemptyset(&none);
+    sigprocmask(SIG_SETMASK, &none, nullptr);
+}
+
+pid_t ProcessManager::forkExec(char* const argv[], const SpawnOptions& options) {
     pid_t pid = fork();
 
     if (pid < 0) {
@@ -17,28 +84,75 @@ pid_t ProcessManager::createProcess(const std::vector<std::string>& args) {
 
     if (pid == 0) {
         // Child process
-        
-        // Convert args to char**
-        std::vector<char*> execArgs;
-        for (const std::string &arg : args)
-            execArgs.push_back((char*)arg.c_str());
-        execArgs.push_back(nullptr);
-
-        execvp(execArgs[0], execArgs.data());
+        prepareChild(options);
+        execvp(argv[0], argv);
 
         // Exec fails:
         perror("execvp failed");
         exit(1);
     }
+    return pid;
+}
 
-    // Parent process
-    ProcessInfo info;
-    info.pid = pid;
-    info.command = args[0];
-    info.state = ProcessState::RUNNING;
+// The child shares our memory until it execs, so it can hand exec's
+// errno back through a local variable.
+pid_t ProcessManager::vforkExec(char* const argv[], const SpawnOptions& options) {
+    volatile int execErrno = 0;
+    pid_t pid = vfork();
 
-    processes.push_back(info);
+    if (pid < 0) {
+        perror("vfork failed");
+        return -1;
+    }
 
+    if (pid == 0) {
+        prepareChild(options);
+        execvp(argv[0], argv);
+        execErrno = errno;
+        _exit(127);
+    }
+
+    if (execErrno != 0) {
+        waitpid(pid, nullptr, 0);
+        errno = execErrno;
+        perror("execvp failed");
+        return -1;
+    }
+    return pid;
+}
+
+pid_t ProcessManager::posixSpawn(char* const argv[], const SpawnOptions& options) {
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (options.stdinFd != -1)
+        posix_spawn_file_actions_adddup2(&actions, options.stdinFd, STDIN_FILENO);
+    if (options.stdoutFd != -1)
+        posix_spawn_file_actions_adddup2(&actions, options.stdoutFd, STDOUT_FILENO);
+    if (options.stderrFd != -1)
+        posix_spawn_file_actions_adddup2(&actions, options.stderrFd, STDERR_FILENO);
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    short flags = POSIX_SPAWN_SETSIGMASK;
+    sigset_t none;
+    sigemptyset(&none);
+    posix_spawnattr_setsigmask(&attr, &none);
+    if (options.newProcessGroup) {
+        flags |= POSIX_SPAWN_SETPGROUP;
+        posix_spawnattr_setpgroup(&attr, 0);
+    }
+    posix_spawnattr_setflags(&attr, flags);
+
+    pid_t pid;
+    int err = posix_spawnp(&pid, argv[0], &actions, &attr, argv, environ);
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+
+    if (err != 0) {
+        errno = err;
+        perror("posix_spawnp failed");
+        return -1;
+    }
     return pid;
 }
 
@@ -46,8 +160,17 @@ pid_t ProcessManager::createProcess(const std::vector<std::string>& args) {
 // Terminate process
 
 bool ProcessManager::terminateProcess(pid_t pid) {
-    if (kill(pid, SIGTERM) == 0)
+    std::lock_guard<std::mutex> lock(mtx);
+    ProcessInfo* proc = table.find(pid);
+    if (!proc) {
+        std::cerr << "terminateProcess: " << pid << " is not a running child" << std::endl;
+        return false;
+    }
+
+    if (kill(pid, SIGTERM) == 0) {
+        proc->state = ProcessState::TERMINATING;
         return true;
+    }
 
     perror("kill failed");
     return false;
@@ -56,36 +179,403 @@ bool ProcessManager::terminateProcess(pid_t pid) {
 
 // Update process states
 
+static uint64_t micros(const struct timeval& tv) {
+    return static_cast<uint64_t>(tv.tv_sec) * 1000000 + static_cast<uint64_t>(tv.tv_usec);
+}
+
+// Called with mtx held; hands the child's callback, if any, to 'fired'.
+// 'usage' is null when the child was reaped elsewhere.
+void ProcessManager::markExited(pid_t pid, int status, const struct rusage* usage,
+                                std::vector<Completion>& fired) {
+    ProcessInfo* proc = table.find(pid);
+    if (proc && usage) {
+        ProcessUsage& u = proc->usage;
+        u.userTimeUs = micros(usage->ru_utime);
+        u.systemTimeUs = micros(usage->ru_stime);
+        u.rssBytes = 0;
+        uint64_t maxRss = static_cast<uint64_t>(usage->ru_maxrss) * 1024;   // KiB
+        if (maxRss > u.peakRssBytes) {
+            u.peakRssBytes = maxRss;
+        }
+        u.minorFaults = usage->ru_minflt;
+        u.majorFaults = usage->ru_majflt;
+        u.voluntarySwitches = usage->ru_nvcsw;
+        u.involuntarySwitches = usage->ru_nivcsw;
+        u.readBytes = static_cast<uint64_t>(usage->ru_inblock) * 512;
+        u.writeBytes = static_cast<uint64_t>(usage->ru_oublock) * 512;
+        u.final = true;
+    }
+
+    auto cb = callbacks.find(pid);
+    if (cb == callbacks.end()) {
+        table.markExited(pid, status);
+        return;
+    }
+    ProcessInfo info;
+    if (table.markExited(pid, status, &info)) {
+        fired.emplace_back(std::move(cb->second), std::move(info));
+    }
+    callbacks.erase(cb);
+}
+
 void ProcessManager::updateProcessStates() {
-    for (auto &proc : processes) {
-        int status;
-        pid_t result = waitpid(proc.pid, &status, WNOHANG);
+    std::vector<Completion> fired;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (reaper) {
+            return;
+        }
 
-        if (result == 0) {
-            proc.state = ProcessState::RUNNING;
+        bool scan = false;
+        while (true) {
+            siginfo_t info;
+            info.si_pid = 0;
+            if (waitid(P_ALL, 0, &info, WEXITED | WNOHANG | WNOWAIT) == -1 || info.si_pid == 0) {
+                break;
+            }
+            if (!table.find(info.si_pid)) {
+                scan = true;    // not ours; leave it for whoever started it
+                break;
+            }
+            int status;
+            struct rusage usage;
+            bool reaped = wait4(info.si_pid, &status, WNOHANG, &usage) == info.si_pid;
+            markExited(info.si_pid, reaped ? status : -1, reaped ? &usage : nullptr, fired);
         }
-        else if (result == proc.pid) {
-            proc.state = ProcessState::TERMINATED;
+
+        if (scan) {
+            // markExited() reorders the table, so collect first.
+            struct Exited {
+                pid_t pid;
+                int status;
+                struct rusage usage;
+            };
+            std::vector<Exited> exited;
+            table.forEach([&exited](const ProcessInfo& proc) {
+                Exited e;
+                if (wait4(proc.pid, &e.status, WNOHANG, &e.usage) == proc.pid) {
+                    e.pid = proc.pid;
+                    exited.push_back(e);
+                }
+            });
+            for (const Exited& e : exited) {
+                markExited(e.pid, e.status, &e.usage, fired);
+            }
         }
     }
+
+    for (Completion& c : fired) {
+        c.first(c.second);
+    }
 }
 
-// Print Process Table
+// Asynchronous reaping
 
-void ProcessManager::printProcessTable() const {
-    std::cout << "\n=== PROCESS TABLE ===\n";
-    for (const auto &proc : processes) {
-        std::string state;
+// Called with mtx held.
+bool ProcessManager::watchExit(pid_t pid) {
+    return reaper->watchChild(pid, [this](pid_t child, int status, const struct rusage& usage) {
+        onReaped(child, status, status == -1 ? nullptr : &usage);
+    });
+}
+
+// Runs on the reaper thread.
+void ProcessManager::onReaped(pid_t pid, int status, const struct rusage* usage) {
+    std::vector<Completion> fired;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        markExited(pid, status, usage, fired);
+    }
+    for (Completion& c : fired) {
+        c.first(c.second);
+    }
+}
 
-        switch (proc.state) {
-            case ProcessState::RUNNING: state = "RUNNING"; break;
-            case ProcessState::STOPPED: state = "STOPPED"; break;
-            case ProcessState::TERMINATED: state = "TERMINATED"; break;
+bool ProcessManager::startReaper() {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (reaper) {
+        return true;
+    }
+    reaper.reset(new EventLoop());
+    if (!reaper->isOpen()) {
+        reaper.reset();
+        return false;
+    }
+    table.forEach([this](const ProcessInfo& proc) {
+        watchExit(proc.pid);
+    });
+
+    EventLoop* loop = reaper.get();
+    reaperThread = std::thread([loop]() { loop->run(); });
+    return true;
+}
+
+void ProcessManager::stopReaper() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!reaper) {
+            return;
+        }
+        reaper->stop();
+    }
+    // The loop thread may be waiting for mtx in onReaped().
+    reaperThread.join();
+
+    std::lock_guard<std::mutex> lock(mtx);
+    reaper.reset();
+}
+
+bool ProcessManager::reaperRunning() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return reaper != nullptr;
+}
+
+// Resource sampling
+
+bool ProcessManager::openProcFiles(pid_t pid, ProcFiles& files) {
+    std::string dir = "/proc/" + std::to_string(pid);
+    files.stat = open((dir + "/stat").c_str(), O_RDONLY | O_CLOEXEC);
+    files.status = open((dir + "/status").c_str(), O_RDONLY | O_CLOEXEC);
+    files.io = open((dir + "/io").c_str(), O_RDONLY | O_CLOEXEC);   // may be refused
+    files.pass = 0;
+    return files.stat != -1;
+}
+
+void ProcessManager::closeProcFiles(ProcFiles& files) {
+    if (files.stat != -1) close(files.stat);
+    if (files.status != -1) close(files.status);
+    if (files.io != -1) close(files.io);
+    files.stat = -1;
+    files.status = -1;
+    files.io = -1;
+}
+
+// Value after "key:" in a /proc/<pid>/io or /proc/<pid>/status buffer
+static uint64_t procField(const char* buf, const char* key) {
+    const char* p = strstr(buf, key);
+    return p ? strtoull(p + strlen(key), nullptr, 10) : 0;
+}
+
+// Reads the files of one child. The descriptors belong to the process
+// that was opened, so once it is gone the reads fail (ESRCH) rather than
+// return another process that reused the pid.
+bool ProcessManager::readUsage(const ProcFiles& files, ProcessUsage& out) const {
+    out = ProcessUsage();
+    char buf[4096];     // /proc/<pid>/status is the largest, about 1.5 KiB
+    ssize_t n = pread(files.stat, buf, sizeof(buf) - 1, 0);
+    if (n <= 0) {
+        return false;
+    }
+    buf[n] = '\0';
+
+    // Fields after the command name, which may itself contain ')' and spaces
+    const char* p = strrchr(buf, ')');
+    if (!p) {
+        return false;
+    }
+    p += 2;     // field 3, the state
+    uint64_t fields[25] = {};
+    for (int field = 3; field <= 24 && *p; ++field) {
+        char* end;
+        fields[field] = strtoull(p, &end, 10);
+        p = end;
+        while (*p && *p != ' ') ++p;
+        while (*p == ' ') ++p;
+    }
+    uint64_t hz = clockTicks > 0 ? static_cast<uint64_t>(clockTicks) : 100;
+    out.minorFaults = fields[10];
+    out.majorFaults = fields[12];
+    out.userTimeUs = fields[14] * 1000000 / hz;
+    out.systemTimeUs = fields[15] * 1000000 / hz;
+    out.rssBytes = fields[24] * static_cast<uint64_t>(pageSize);
+
+    // The kernel's own high-water mark and switch counters, so peaks and
+    // switches between two passes are not missed
+    if (files.status != -1) {
+        n = pread(files.status, buf, sizeof(buf) - 1, 0);
+        if (n > 0) {
+            buf[n] = '\0';
+            out.peakRssBytes = procField(buf, "\nVmHWM:") * 1024;
+            out.voluntarySwitches = procField(buf, "\nvoluntary_ctxt_switches:");
+            out.involuntarySwitches = procField(buf, "\nnonvoluntary_ctxt_switches:");
+        }
+    }
+
+    if (files.io != -1) {
+        n = pread(files.io, buf, sizeof(buf) - 1, 0);
+        if (n > 0) {
+            buf[n] = '\0';
+            out.readChars = procField(buf, "rchar:");
+            out.writeChars = procField(buf, "wchar:");
+            out.readBytes = procField(buf, "read_bytes:");
+            out.writeBytes = procField(buf, "\nwrite_bytes:");
+        }
+    }
+    return true;
+}
+
+void ProcessManager::sampleNow() {
+    std::lock_guard<std::mutex> sampling(samplerMtx);
+    ++samplePass;
+
+    samplePids.clear();
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        table.forEach([this](const ProcessInfo& proc) {
+            samplePids.push_back(proc.pid);
+        });
+    }
+    sampleData.resize(samplePids.size());
+    sampleOk.assign(samplePids.size(), 0);
+
+    for (size_t i = 0; i < samplePids.size(); ++i) {
+        pid_t pid = samplePids[i];
+        auto it = procFiles.find(pid);
+        bool ok = false;
+        if (it != procFiles.end()) {
+            ok = readUsage(it->second, sampleData[i]);
+            if (!ok) {
+                // Cached for an earlier process with this pid
+                closeProcFiles(it->second);
+                procFiles.erase(it);
+                it = procFiles.end();
+            }
+        }
+        if (it == procFiles.end()) {
+            ProcFiles files;
+            if (!openProcFiles(pid, files)) {
+                closeProcFiles(files);
+                continue;
+            }
+            it = procFiles.emplace(pid, files).first;
+            ok = readUsage(files, sampleData[i]);
         }
+        it->second.pass = samplePass;
+        sampleOk[i] = ok;
+    }
+
+    // Children that are gone
+    for (auto it = procFiles.begin(); it != procFiles.end();) {
+        if (it->second.pass != samplePass) {
+            closeProcFiles(it->second);
+            it = procFiles.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    for (size_t i = 0; i < samplePids.size(); ++i) {
+        ProcessInfo* proc = sampleOk[i] ? table.find(samplePids[i]) : nullptr;
+        if (!proc || proc->usage.final) {
+            continue;
+        }
+        const ProcessUsage& s = sampleData[i];
+        ProcessUsage& u = proc->usage;
+        u.userTimeUs = s.userTimeUs;
+        u.systemTimeUs = s.systemTimeUs;
+        u.rssBytes = s.rssBytes;
+        uint64_t peak = s.peakRssBytes > s.rssBytes ? s.peakRssBytes : s.rssBytes;
+        if (peak > u.peakRssBytes) {
+            u.peakRssBytes = peak;
+        }
+        u.minorFaults = s.minorFaults;
+        u.majorFaults = s.majorFaults;
+        u.voluntarySwitches = s.voluntarySwitches;
+        u.involuntarySwitches = s.involuntarySwitches;
+        u.readBytes = s.readBytes;
+        u.writeBytes = s.writeBytes;
+        u.readChars = s.readChars;
+        u.writeChars = s.writeChars;
+        ++u.samples;
+    }
+}
+
+bool ProcessManager::startSampler(std::chrono::milliseconds interval) {
+    // Not mtx: every sampling pass takes it, so stopSampler() would
+    // deadlock joining the thread under it.
+    std::lock_guard<std::mutex> control(samplerStartMtx);
+    if (samplerThread.joinable()) {
+        return true;
+    }
+    samplerStopping = false;
+    samplerThread = std::thread([this, interval]() {
+        std::unique_lock<std::mutex> lock(samplerCtlMtx);
+        while (!samplerStopping) {
+            lock.unlock();
+            sampleNow();
+            lock.lock();
+            samplerCv.wait_for(lock, interval, [this]() { return samplerStopping; });
+        }
+    });
+    return true;
+}
+
+void ProcessManager::stopSampler() {
+    std::lock_guard<std::mutex> control(samplerStartMtx);
+    if (!samplerThread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(samplerCtlMtx);
+        samplerStopping = true;
+    }
+    samplerCv.notify_all();
+    samplerThread.join();
+}
 
-        std::cout << "PID: " << proc.pid
-                  << " | CMD: " << proc.command
-                  << " | STATE: " << state << "\n";
+bool ProcessManager::processInfo(pid_t pid, ProcessInfo& out) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    const ProcessInfo* info = table.find(pid);
+    if (!info) {
+        info = table.findExited(pid);
     }
+    if (!info) {
+        return false;
+    }
+    out = *info;
+    return true;
+}
+
+size_t ProcessManager::processCount() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return table.size();
+}
+
+// Print Process Table
+
+static void printProcess(const ProcessInfo& proc) {
+    std::string state;
+
+    switch (proc.state) {
+        case ProcessState::RUNNING: state = "RUNNING"; break;
+        case ProcessState::STOPPED: state = "STOPPED"; break;
+        case ProcessState::TERMINATING: state = "TERMINATING"; break;
+        case ProcessState::TERMINATED: state = "TERMINATED"; break;
+    }
+
+    std::cout << "PID: " << proc.pid
+              << " | CMD: " << proc.command
+              << " | STATE: " << state;
+    if (proc.exitStatus != -1) {
+        if (WIFEXITED(proc.exitStatus)) {
+            std::cout << " | EXIT: " << WEXITSTATUS(proc.exitStatus);
+        } else if (WIFSIGNALED(proc.exitStatus)) {
+            std::cout << " | SIGNAL: " << WTERMSIG(proc.exitStatus);
+        }
+    }
+    const ProcessUsage& u = proc.usage;
+    if (u.final || u.samples > 0) {
+        std::cout << " | CPU: " << (u.userTimeUs + u.systemTimeUs) / 1000 << " ms"
+                  << " | PEAK RSS: " << u.peakRssBytes / 1024 << " KB";
+    }
+    std::cout << "\n";
+}
+
+// Live children first, then the recent exits, oldest first.
+void ProcessManager::printProcessTable() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::cout << "\n=== PROCESS TABLE ===\n";
+    table.forEach(printProcess);
+    table.forEachExited(printProcess);
     std::cout << "======================\n";
 }
\ No newline at end of file
@@ -1,33 +1,162 @@
 #ifndef PROCESS_MANAGER_H
 #define PROCESS_MANAGER_H
 
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include <sys/types.h>
 
-enum class ProcessState {
-    RUNNING,
-    STOPPED,
-    TERMINATED
+#include "process_table.h"
+
+class EventLoop;
+
+// How createProcess() starts the child
+enum class SpawnMethod {
+    AUTO,          // POSIX_SPAWN
+    FORK_EXEC,     // fork() + execvp(); copies the parent's page tables
+    POSIX_SPAWN,   // posix_spawnp(); glibc runs it on a CLONE_VM|CLONE_VFORK child
+    VFORK          // vfork() + execvp(); child borrows the parent's memory until exec
 };
 
-struct ProcessInfo {
-    pid_t pid;
-    std::string command;
-    ProcessState state;
+struct SpawnOptions {
+    SpawnMethod method = SpawnMethod::AUTO;
+
+    // Descriptors to install as the child's stdin/stdout/stderr; -1 keeps
+    // the parent's. E.g. a Pipe end from IPCManager::createPipe.
+    int stdinFd = -1;
+    int stdoutFd = -1;
+    int stderrFd = -1;
+
+    // Put the child in a new process group of its own
+    bool newProcessGroup = false;
 };
 
 class ProcessManager {
 public:
-    ProcessManager();
+    // Called once a child has been reaped, with its final entry
+    using ExitCallback = std::function<void(const ProcessInfo& info)>;
+
+    // 'historySize': how many exited children the table keeps for
+    // post-mortem (see ProcessTable)
+    explicit ProcessManager(size_t historySize = ProcessTable::DEFAULT_HISTORY);
+    ~ProcessManager();
+
+    ProcessManager(const ProcessManager&) = delete;
+    ProcessManager& operator=(const ProcessManager&) = delete;
 
-    pid_t createProcess(const std::vector<std::string>& args);
+    // Starts args[0] (searched in PATH) with 'args' as its argv. With
+    // POSIX_SPAWN and VFORK an exec failure is reported here (-1), not
+    // by a child that exits with an error. The child starts with an
+    // empty signal mask whatever the calling thread blocks.
+    // 'onExit' runs when the child is reaped: on the reaper thread with
+    // startReaper(), otherwise inside updateProcessStates().
+    pid_t createProcess(const std::vector<std::string>& args,
+                        const SpawnOptions& options = SpawnOptions(),
+                        ExitCallback onExit = nullptr);
+
+    // Sends SIGTERM to a live child of ours and marks it TERMINATING until
+    // it is reaped. Refuses pids that are not (or no longer) ours, which
+    // may belong to an unrelated process by now.
     bool terminateProcess(pid_t pid);
+
+    // Polls for exited children. Every exited child of ours is found with
+    // waitid(WNOWAIT) and reaped by pid, so the cost follows the number of
+    // exits, not of entries; a zombie that is not ours makes it fall back
+    // to checking each running entry. Does nothing while the reaper runs.
     void updateProcessStates();
+
+    // Reaps children as they exit instead: a thread running an EventLoop
+    // is told about each exit through a pidfd (or SIGCHLD on old kernels,
+    // see EventLoop), so states, exit statuses and callbacks are current
+    // without polling. Also covers children created before the call.
+    bool startReaper();
+    void stopReaper();
+    bool reaperRunning() const;
+
+    // Resource accounting: a single sampler thread refreshes the usage of
+    // every live child from /proc/<pid>/stat, /status and /io every
+    // 'interval'. The files stay open per child between passes (pread()
+    // at offset 0 re-reads them), and the table is locked once to list
+    // the children and once to store the results, so a pass costs three
+    // small reads per child. Whatever the sampler saw, a child's usage is
+    // replaced by its exact rusage when it is reaped. Starting and
+    // stopping are safe from any thread.
+    bool startSampler(std::chrono::milliseconds interval = std::chrono::milliseconds(1000));
+    void stopSampler();
+
+    // One sampling pass on the calling thread, with or without the sampler
+    void sampleNow();
+
+    // Copy of the entry for 'pid', live or among the recent exits; false
+    // if it is neither.
+    bool processInfo(pid_t pid, ProcessInfo& out) const;
+
+    // Live children; calls fn(const ProcessInfo&) for each under the
+    // table lock, without copying or allocating. 'fn' must not call back
+    // into this ProcessManager.
+    template <typename F>
+    void forEachProcess(F&& fn) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        table.forEach(fn);
+    }
+    size_t processCount() const;
+
     void printProcessTable() const;
 
 private:
-    std::vector<ProcessInfo> processes;
+    static pid_t forkExec(char* const argv[], const SpawnOptions& options);
+    static pid_t posixSpawn(char* const argv[], const SpawnOptions& options);
+    static pid_t vforkExec(char* const argv[], const SpawnOptions& options);
+
+    using Completion = std::pair<ExitCallback, ProcessInfo>;
+
+    // Cached /proc descriptors of one child
+    struct ProcFiles {
+        int stat;
+        int status;
+        int io;
+        uint64_t pass;      // last sampling pass that saw the child
+    };
+
+    bool watchExit(pid_t pid);
+    void onReaped(pid_t pid, int status, const struct rusage* usage);
+    void markExited(pid_t pid, int status, const struct rusage* usage,
+                    std::vector<Completion>& fired);
+
+    static bool openProcFiles(pid_t pid, ProcFiles& files);
+    static void closeProcFiles(ProcFiles& files);
+    bool readUsage(const ProcFiles& files, ProcessUsage& out) const;
+
+    ProcessTable table;
+    std::unordered_map<pid_t, ExitCallback> callbacks;   // children with an onExit
+    mutable std::mutex mtx;                              // guards the two above
+
+    std::unique_ptr<EventLoop> reaper;
+    std::thread reaperThread;
+
+    // Sampler state, guarded by samplerMtx (one pass at a time)
+    std::mutex samplerMtx;
+    std::unordered_map<pid_t, ProcFiles> procFiles;
+    std::vector<pid_t> samplePids;          // reused by every pass
+    std::vector<ProcessUsage> sampleData;
+    std::vector<char> sampleOk;
+    uint64_t samplePass;
+    long clockTicks;                        // sysconf(_SC_CLK_TCK)
+    long pageSize;
+
+    std::thread samplerThread;
+    std::mutex samplerStartMtx;             // serializes startSampler/stopSampler
+    std::mutex samplerCtlMtx;               // guards samplerStopping
+    std::condition_variable samplerCv;
+    bool samplerStopping;
 };
 
 #endif
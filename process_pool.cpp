@@ -0,0 +1,603 @@
+#include "process_pool.h"
+#include "ipc_manager.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+
+// Replies start with one status byte: the handler's return value follows
+// REPLY_OK, the what() of its exception follows REPLY_ERROR.
+static const char REPLY_OK = 0;
+static const char REPLY_ERROR = 1;
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+#ifndef SYS_pidfd_send_signal
+#define SYS_pidfd_send_signal 424
+#endif
+
+// The zygote answers each spawn request with the worker's pid and, as
+// SCM_RIGHTS, the parent's ends of its request and reply pipes plus, when
+// the kernel has pidfd_open(), a pidfd for the worker. The zygote reaps
+// its workers, so their pids may be reused at any time; the pidfd is the
+// only safe way for the pool to signal one.
+static bool sendWorker(int sock, pid_t pid, int toWorker, int fromWorker, int pidfd) {
+    struct iovec iov = {&pid, sizeof(pid)};
+    char control[CMSG_SPACE(3 * sizeof(int))];
+    memset(control, 0, sizeof(control));
+
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (pid > 0) {
+        int fds[3] = {toWorker, fromWorker, pidfd};
+        size_t count = pidfd != -1 ? 3 : 2;
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(count * sizeof(int));
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(count * sizeof(int));
+        memcpy(CMSG_DATA(cmsg), fds, count * sizeof(int));
+    }
+
+    ssize_t n;
+    do {
+        n = sendmsg(sock, &msg, MSG_NOSIGNAL);
+    } while (n == -1 && errno == EINTR);
+    return n == static_cast<ssize_t>(sizeof(pid));
+}
+
+static bool receiveWorker(int sock, pid_t& pid, int& toWorker, int& fromWorker, int& pidfd) {
+    struct iovec iov = {&pid, sizeof(pid)};
+    char control[CMSG_SPACE(3 * sizeof(int))];
+
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t n;
+    do {
+        n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    } while (n == -1 && errno == EINTR);
+    if (n != static_cast<ssize_t>(sizeof(pid)) || pid <= 0) {
+        return false;
+    }
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS) {
+        return false;
+    }
+    int fds[3] = {-1, -1, -1};
+    if (cmsg->cmsg_len == CMSG_LEN(3 * sizeof(int))) {
+        memcpy(fds, CMSG_DATA(cmsg), 3 * sizeof(int));
+    } else if (cmsg->cmsg_len == CMSG_LEN(2 * sizeof(int))) {
+        memcpy(fds, CMSG_DATA(cmsg), 2 * sizeof(int));
+    } else {
+        return false;
+    }
+    toWorker = fds[0];
+    fromWorker = fds[1];
+    pidfd = fds[2];
+    return true;
+}
+
+ProcessPool::ProcessPool(size_t numWorkers, Handler handler)
+    : ProcessPool([numWorkers]() {
+          ProcessPoolConfig config;
+          config.numWorkers = numWorkers;
+          return config;
+      }(), std::move(handler)) {}
+
+ProcessPool::ProcessPool(const ProcessPoolConfig& cfg, Handler h)
+    : config(cfg), handler(std::move(h)), live(0), respawned(0),
+      stopping(false), stopped(false), zygotePid(-1), zygoteFd(-1) {
+    if (config.numWorkers == 0) {
+        config.numWorkers = 1;
+    }
+
+    struct sigaction sa;
+    if (sigaction(SIGPIPE, nullptr, &sa) == 0 && sa.sa_handler == SIG_DFL) {
+        signal(SIGPIPE, SIG_IGN);
+    }
+
+    if (config.zygote) {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) == -1) {
+            perror("socketpair failed");
+        } else {
+            pid_t pid = fork();
+            if (pid == 0) {
+                close(sv[0]);
+                runZygote(sv[1]);
+                _exit(0);
+            }
+            close(sv[1]);
+            if (pid < 0) {
+                perror("fork failed");
+                close(sv[0]);
+            } else {
+                zygotePid = pid;
+                zygoteFd = sv[0];
+            }
+        }
+        if (zygoteFd == -1) {
+            fprintf(stderr, "ProcessPool: no zygote, forking workers directly\n");
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (size_t i = 0; i < config.numWorkers; ++i) {
+            workers.push_back(std::make_unique<Worker>(config.maxFrame));
+        }
+        for (size_t i = 0; i < config.numWorkers; ++i) {
+            startWorker(i);
+        }
+    }
+
+    loopThread = std::thread([this]() { loop.run(); });
+}
+
+ProcessPool::~ProcessPool() {
+    shutdown();
+}
+
+// -------------------------------
+// Worker processes
+// -------------------------------
+
+// Runs in the worker until the pool closes the request pipe.
+void ProcessPool::runWorker(int requests, int replies) {
+    FrameReader reader(requests, config.maxFrame);
+    std::string reply;
+    const char* data;
+    size_t len;
+
+    while (reader.next(data, len) == FrameReader::Status::OK) {
+        reply.assign(1, REPLY_OK);
+        try {
+            reply += handler(std::string(data, len));
+        } catch (const std::exception& e) {
+            reply.assign(1, REPLY_ERROR);
+            reply += e.what();
+        } catch (...) {
+            reply.assign(1, REPLY_ERROR);
+            reply += "unknown exception";
+        }
+        if (!IPCManager::writeFrame(replies, reply.data(), reply.size())) {
+            break;
+        }
+    }
+}
+
+// Forks one worker per byte received on 'control' until the pool closes it.
+void ProcessPool::runZygote(int control) {
+    signal(SIGCHLD, SIG_IGN);   // workers are reaped by the kernel
+
+    char request;
+    while (read(control, &request, 1) == 1) {
+        Pipe req, rep;
+        if (!IPCManager::createPipe(req)) {
+            sendWorker(control, -1, -1, -1, -1);
+            continue;
+        }
+        if (!IPCManager::createPipe(rep)) {
+            close(req.readFd);
+            close(req.writeFd);
+            sendWorker(control, -1, -1, -1, -1);
+            continue;
+        }
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            signal(SIGCHLD, SIG_DFL);
+            close(control);
+            close(req.writeFd);
+            close(rep.readFd);
+            runWorker(req.readFd, rep.writeFd);
+            _exit(0);
+        }
+        close(req.readFd);
+        close(rep.writeFd);
+        // The worker waits for its first request, so it is still there
+        // to be opened; if pidfd_open() is missing it goes without one.
+        int pidfd = -1;
+        if (pid < 0) {
+            perror("fork failed");
+        } else {
+            pidfd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+        }
+        sendWorker(control, pid, req.writeFd, rep.readFd, pidfd);
+        close(req.writeFd);
+        close(rep.readFd);
+        if (pidfd != -1) {
+            close(pidfd);
+        }
+    }
+}
+
+bool ProcessPool::zygoteSpawn(pid_t& pid, int& pidfd, int& toWorker, int& fromWorker) {
+    std::lock_guard<std::mutex> lock(zygoteMtx);
+    char request = 'S';
+    if (write(zygoteFd, &request, 1) != 1) {
+        perror("zygote request failed");
+        return false;
+    }
+    if (!receiveWorker(zygoteFd, pid, toWorker, fromWorker, pidfd)) {
+        fprintf(stderr, "ProcessPool: zygote could not start a worker\n");
+        return false;
+    }
+    return true;
+}
+
+// Called with mtx held, so no other worker is being started.
+bool ProcessPool::forkWorker(pid_t& pid, int& toWorker, int& fromWorker) {
+    Pipe req, rep;
+    if (!IPCManager::createPipe(req)) {
+        return false;
+    }
+    if (!IPCManager::createPipe(rep)) {
+        close(req.readFd);
+        close(req.writeFd);
+        return false;
+    }
+
+    pid = fork();
+    if (pid == 0) {
+        close(req.writeFd);
+        close(rep.readFd);
+        // Other workers' pipes would keep them open after they die.
+        for (const auto& w : workers) {
+            if (w->toWorker != -1) close(w->toWorker);
+            if (w->fromWorker != -1) close(w->fromWorker);
+        }
+        runWorker(req.readFd, rep.writeFd);
+        _exit(0);
+    }
+
+    close(req.readFd);
+    close(rep.writeFd);
+    if (pid < 0) {
+        perror("fork failed");
+        close(req.writeFd);
+        close(rep.readFd);
+        return false;
+    }
+    fcntl(req.writeFd, F_SETFD, FD_CLOEXEC);
+    fcntl(rep.readFd, F_SETFD, FD_CLOEXEC);
+    toWorker = req.writeFd;
+    fromWorker = rep.readFd;
+    return true;
+}
+
+// Called with mtx held.
+bool ProcessPool::startWorker(size_t slot) {
+    Worker& w = *workers[slot];
+    pid_t pid;
+    int pidfd = -1;
+    int toWorker, fromWorker;
+    bool ok = zygoteFd != -1 ? zygoteSpawn(pid, pidfd, toWorker, fromWorker)
+                             : forkWorker(pid, toWorker, fromWorker);
+    if (!ok) {
+        return false;
+    }
+
+    fcntl(toWorker, F_SETFL, fcntl(toWorker, F_GETFL) | O_NONBLOCK);
+    fcntl(fromWorker, F_SETFL, fcntl(fromWorker, F_GETFL) | O_NONBLOCK);
+    w.pid = pid;
+    w.pidfd = pidfd;
+    w.toWorker = toWorker;
+    w.fromWorker = fromWorker;
+    w.reader.reset(fromWorker);
+    w.busy = false;
+    w.replied = false;
+    ++live;
+
+    loop.watch(fromWorker, EPOLLIN, [this, slot](int fd, uint32_t) {
+        onReadable(slot, fd);
+    });
+
+    if (!queue.empty() && dispatchLocked(slot, queue.front())) {
+        queue.pop_front();
+    }
+    return true;
+}
+
+// Called with mtx held. Writes what the request pipe takes now and
+// leaves the rest to onWritable(). Leaves 'r' untouched if the worker
+// is gone.
+bool ProcessPool::dispatchLocked(size_t slot, Request& r) {
+    Worker& w = *workers[slot];
+    uint32_t header = static_cast<uint32_t>(r.payload.size());
+    struct iovec iov[2] = {
+        {&header, sizeof(header)},
+        {const_cast<char*>(r.payload.data()), r.payload.size()}
+    };
+    ssize_t n;
+    do {
+        n = writev(w.toWorker, iov, 2);
+    } while (n == -1 && errno == EINTR);
+    if (n == -1 && errno != EAGAIN) {
+        return false;
+    }
+
+    size_t sent = n == -1 ? 0 : static_cast<size_t>(n);
+    if (sent < sizeof(header) + r.payload.size()) {
+        w.outbox.assign(reinterpret_cast<const char*>(&header), sizeof(header));
+        w.outbox += r.payload;
+        w.outSent = sent;
+        loop.watch(w.toWorker, EPOLLOUT, [this, slot](int fd, uint32_t) {
+            onWritable(slot, fd);
+        });
+    }
+    w.current = std::move(r.promise);
+    w.busy = true;
+    return true;
+}
+
+// Called with mtx held. False if the worker can no longer be written to.
+bool ProcessPool::flushLocked(Worker& w) {
+    while (w.outSent < w.outbox.size()) {
+        ssize_t n = write(w.toWorker, w.outbox.data() + w.outSent,
+                          w.outbox.size() - w.outSent);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN;
+        }
+        w.outSent += static_cast<size_t>(n);
+    }
+    loop.unwatch(w.toWorker);
+    w.outbox.clear();
+    w.outSent = 0;
+    return true;
+}
+
+// -------------------------------
+// Event loop thread
+// -------------------------------
+
+void ProcessPool::onReadable(size_t slot, int fd) {
+    std::lock_guard<std::mutex> lock(mtx);
+    Worker& w = *workers[slot];
+    if (w.fromWorker != fd) {
+        return;     // stale event for a worker already replaced
+    }
+
+    const char* data;
+    size_t len;
+    while (true) {
+        FrameReader::Status s = w.reader.next(data, len);
+        if (s == FrameReader::Status::AGAIN) {
+            return;
+        }
+        if (s != FrameReader::Status::OK) {
+            workerExited(slot, s == FrameReader::Status::ERROR);
+            return;
+        }
+
+        w.replied = true;
+        w.failedStarts = 0;
+        if (w.busy) {
+            w.busy = false;
+            if (len > 0 && data[0] == REPLY_OK) {
+                w.current.set_value(std::string(data + 1, len - 1));
+            } else {
+                std::string what = len > 0 ? std::string(data + 1, len - 1) : "empty reply";
+                w.current.set_exception(std::make_exception_ptr(std::runtime_error(what)));
+            }
+        }
+
+        if (!queue.empty()) {
+            if (dispatchLocked(slot, queue.front())) {
+                queue.pop_front();
+            }
+        } else {
+            idle.notify_all();
+        }
+    }
+}
+
+void ProcessPool::onWritable(size_t slot, int fd) {
+    std::lock_guard<std::mutex> lock(mtx);
+    Worker& w = *workers[slot];
+    if (w.toWorker != fd || w.outbox.empty()) {
+        return;     // stale event, or flushed already
+    }
+    if (!flushLocked(w)) {
+        workerExited(slot, true);
+    }
+}
+
+// A worker closed by closeWorker() has been reaped.
+void ProcessPool::onReaped(pid_t pid) {
+    std::lock_guard<std::mutex> lock(mtx);
+    for (size_t i = 0; i < exiting.size(); ++i) {
+        if (exiting[i] == pid) {
+            exiting[i] = exiting.back();
+            exiting.pop_back();
+            break;
+        }
+    }
+}
+
+// Called with mtx held. 'killFirst' for a worker whose stream went bad
+// but that may still be running.
+void ProcessPool::workerExited(size_t slot, bool killFirst) {
+    Worker& w = *workers[slot];
+    if (w.busy) {
+        w.busy = false;
+        w.current.set_exception(std::make_exception_ptr(std::runtime_error(
+            "worker process " + std::to_string(w.pid) + " exited")));
+    }
+    if (killFirst) {
+        killWorker(w);
+    }
+    if (!w.replied) {
+        ++w.failedStarts;
+    }
+    closeWorker(w);
+
+    bool crashLoop = config.maxFailedStarts > 0 && w.failedStarts >= config.maxFailedStarts;
+    if (crashLoop && config.respawn && !stopped) {
+        fprintf(stderr, "ProcessPool: %u workers in a row died before replying, "
+                "not respawning slot %zu\n", w.failedStarts, slot);
+    }
+    if (config.respawn && !stopped && !crashLoop && startWorker(slot)) {
+        ++respawned;
+    }
+    if (live == 0) {
+        failQueuedLocked();
+    }
+    idle.notify_all();
+}
+
+// Called with mtx held. A worker forked here stays a zombie until closeWorker()
+// has it reaped, so its pid is safe to use; one from the zygote is signalled
+// through its pidfd. Without one, closing its pipes has to do.
+void ProcessPool::killWorker(const Worker& w) {
+    if (w.pidfd != -1) {
+        syscall(SYS_pidfd_send_signal, w.pidfd, SIGKILL, nullptr, 0);
+    } else if (zygoteFd == -1) {
+        kill(w.pid, SIGKILL);
+    }
+}
+
+// Called with mtx held. Workers exit on EOF of their request pipe; the
+// event loop reaps the ones forked here (the zygote reaps its own).
+void ProcessPool::closeWorker(Worker& w) {
+    if (w.pid == 0) {
+        return;
+    }
+    loop.unwatch(w.fromWorker);
+    if (!w.outbox.empty()) {
+        loop.unwatch(w.toWorker);
+        w.outbox.clear();
+        w.outSent = 0;
+    }
+    close(w.toWorker);
+    close(w.fromWorker);
+    if (w.pidfd != -1) {
+        close(w.pidfd);
+    }
+    if (zygoteFd == -1) {
+        // Left in 'exiting' if the loop cannot watch it; shutdown() reaps those.
+        exiting.push_back(w.pid);
+        loop.watchChild(w.pid, [this](pid_t pid, int) { onReaped(pid); });
+    }
+    w.pid = 0;
+    w.pidfd = -1;
+    w.toWorker = -1;
+    w.fromWorker = -1;
+    w.reader.reset(-1);
+    --live;
+}
+
+void ProcessPool::failQueuedLocked() {
+    for (Request& r : queue) {
+        r.promise.set_exception(std::make_exception_ptr(
+            std::runtime_error("process pool has no workers")));
+    }
+    queue.clear();
+}
+
+// -------------------------------
+// Public interface
+// -------------------------------
+
+std::future<std::string> ProcessPool::submit(std::string request) {
+    Request r{std::move(request), std::promise<std::string>()};
+    std::future<std::string> future = r.promise.get_future();
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if (stopping || live == 0) {
+        r.promise.set_exception(std::make_exception_ptr(
+            std::runtime_error("process pool is not running")));
+        return future;
+    }
+    for (size_t i = 0; i < workers.size(); ++i) {
+        if (workers[i]->pid != 0 && !workers[i]->busy && dispatchLocked(i, r)) {
+            return future;
+        }
+    }
+    queue.push_back(std::move(r));
+    return future;
+}
+
+size_t ProcessPool::size() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return live;
+}
+
+uint64_t ProcessPool::respawns() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return respawned;
+}
+
+std::vector<pid_t> ProcessPool::pids() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::vector<pid_t> out;
+    for (const auto& w : workers) {
+        out.push_back(w->pid);
+    }
+    return out;
+}
+
+void ProcessPool::shutdown() {
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (stopped) {
+            return;
+        }
+        stopping = true;
+        idle.wait(lock, [this]() {
+            if (live == 0) {
+                return true;
+            }
+            if (!queue.empty()) {
+                return false;
+            }
+            for (const auto& w : workers) {
+                if (w->busy) {
+                    return false;
+                }
+            }
+            return true;
+        });
+        stopped = true;
+        for (const auto& w : workers) {
+            closeWorker(*w);
+        }
+    }
+
+    if (zygoteFd != -1) {
+        close(zygoteFd);            // the zygote exits on EOF
+        waitpid(zygotePid, nullptr, 0);
+        zygoteFd = -1;
+    }
+    loop.stop();
+    if (loopThread.joinable()) {
+        loopThread.join();
+    }
+
+    // Workers the loop had not reaped yet; idle ones exit on EOF promptly.
+    for (pid_t pid : exiting) {
+        while (waitpid(pid, nullptr, 0) == -1 && errno == EINTR) {
+        }
+    }
+    exiting.clear();
+}
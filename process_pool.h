@@ -0,0 +1,154 @@
+#ifndef PROCESS_POOL_H
+#define PROCESS_POOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/types.h>
+
+#include "event_loop.h"
+#include "frame_reader.h"
+
+struct ProcessPoolConfig {
+    size_t numWorkers = 4;
+
+    // Fork the workers from a zygote: a process forked once in the
+    // constructor, before the pool starts any thread, that forks every
+    // worker (respawns included) from that pristine state. Without it
+    // workers are forked from the pool's own event loop thread, so they
+    // inherit whatever the rest of the program looks like at that moment.
+    bool zygote = false;
+
+    // Replace a worker that exits or crashes
+    bool respawn = true;
+
+    // Give up on a slot once this many of its workers in a row died
+    // before sending a single reply, instead of forking replacements that
+    // crash straight away forever (0: no limit)
+    unsigned maxFailedStarts = 5;
+
+    // Largest request or reply
+    size_t maxFrame = FrameReader::DEFAULT_MAX_FRAME;
+};
+
+/*
+ * ProcessPool:
+ * Process counterpart of ThreadPool for work that needs isolation: N
+ * long-lived worker processes, each running 'handler' on the requests
+ * sent to it. A request costs two framed pipe writes instead of a
+ * fork + exec + dynamic linking of a new program.
+ *
+ * Every worker has a request pipe and a reply pipe (IPCManager frames)
+ * and works on one request at a time; the rest wait in the pool's queue.
+ * One event loop thread collects replies and hands the next request to
+ * the worker that just became free.
+ *
+ * A worker that dies takes only its current request with it: that
+ * future gets a std::runtime_error and, with respawn, a fresh worker
+ * takes over the slot, unless the slot keeps losing workers before their
+ * first reply (maxFailedStarts). Once no worker is left, queued requests
+ * fail. Exceptions thrown by the handler are sent back
+ * and rethrown from the future as std::runtime_error with what().
+ *
+ * Request pipes are non-blocking: what a full pipe does not take is
+ * kept in the worker's outbox and flushed from the event loop when the
+ * pipe drains, so neither submit() nor the loop thread ever blocks on a
+ * slow worker. Workers that exit are reaped by the event loop.
+ *
+ * Writing to a dead worker's pipe would raise SIGPIPE, so the pool
+ * ignores SIGPIPE if it still has its default action.
+ */
+class ProcessPool {
+public:
+    using Handler = std::function<std::string(const std::string& request)>;
+
+    ProcessPool(const ProcessPoolConfig& config, Handler handler);
+    ProcessPool(size_t numWorkers, Handler handler);
+    ~ProcessPool();
+
+    ProcessPool(const ProcessPool&) = delete;
+    ProcessPool& operator=(const ProcessPool&) = delete;
+
+    // Queues 'request' for the next free worker; the future yields the
+    // handler's reply.
+    std::future<std::string> submit(std::string request);
+
+    // Live workers
+    size_t size() const;
+
+    // Workers started to replace ones that exited
+    uint64_t respawns() const;
+
+    // Worker pids (0 for a slot without a live worker)
+    std::vector<pid_t> pids() const;
+
+    // Finish queued requests, then stop the workers.
+    void shutdown();
+
+private:
+    struct Worker {
+        explicit Worker(size_t maxFrame) : reader(-1, maxFrame) {}
+
+        pid_t pid = 0;
+        int pidfd = -1;         // from the zygote, which reaps the worker itself
+        int toWorker = -1;      // request pipe, write end (O_NONBLOCK)
+        int fromWorker = -1;    // reply pipe, read end (O_NONBLOCK)
+        FrameReader reader;
+        bool busy = false;
+        bool replied = false;   // this worker has answered a request
+        unsigned failedStarts = 0;  // workers in a row that died without replying
+        std::promise<std::string> current;
+        std::string outbox;     // rest of the current request, waiting for EPOLLOUT
+        size_t outSent = 0;     // bytes of 'outbox' already written
+    };
+
+    struct Request {
+        std::string payload;
+        std::promise<std::string> promise;
+    };
+
+    bool startWorker(size_t slot);
+    bool forkWorker(pid_t& pid, int& toWorker, int& fromWorker);
+    bool zygoteSpawn(pid_t& pid, int& pidfd, int& toWorker, int& fromWorker);
+    void runZygote(int control);
+    void runWorker(int requests, int replies);
+
+    void onReadable(size_t slot, int fd);
+    void onWritable(size_t slot, int fd);
+    void onReaped(pid_t pid);
+    void workerExited(size_t slot, bool killFirst);
+    void killWorker(const Worker& w);
+    void closeWorker(Worker& w);
+    bool dispatchLocked(size_t slot, Request& r);
+    bool flushLocked(Worker& w);
+    void failQueuedLocked();
+
+    ProcessPoolConfig config;
+    Handler handler;
+
+    EventLoop loop;
+    std::thread loopThread;
+
+    mutable std::mutex mtx;
+    std::condition_variable idle;   // queue empty and no worker busy
+    std::vector<std::unique_ptr<Worker>> workers;   // guarded by mtx
+    std::deque<Request> queue;                      // guarded by mtx
+    std::vector<pid_t> exiting;     // closed, not reaped yet (no zygote)
+    size_t live;
+    uint64_t respawned;
+    bool stopping;
+    bool stopped;
+
+    pid_t zygotePid;
+    int zygoteFd;               // control socket to the zygote
+    std::mutex zygoteMtx;       // one spawn request at a time
+};
+
+#endif
@@ -0,0 +1,172 @@
+#include "process_table.h"
+
+static const size_t MIN_BUCKETS = 64;
+
+ProcessTable::ProcessTable(size_t historySize)
+    : shift(64), history(historySize), historyNext(0), historyCount(0) {
+    rehash(MIN_BUCKETS);
+}
+
+// Fibonacci hashing: pids are mostly consecutive, the multiply spreads them.
+size_t ProcessTable::bucketFor(pid_t pid) const {
+    return static_cast<size_t>((static_cast<uint64_t>(static_cast<uint32_t>(pid))
+                                * 0x9E3779B97F4A7C15ull) >> shift);
+}
+
+size_t ProcessTable::lookup(pid_t pid) const {
+    size_t mask = buckets.size() - 1;
+    for (size_t b = bucketFor(pid); ; b = (b + 1) & mask) {
+        if (buckets[b].pid == pid) {
+            return b;
+        }
+        if (buckets[b].pid == 0) {
+            return SIZE_MAX;
+        }
+    }
+}
+
+// Backward-shift deletion: pull later members of the probe run into the
+// hole so lookups never need tombstones.
+void ProcessTable::eraseBucket(size_t b) {
+    size_t mask = buckets.size() - 1;
+    size_t hole = b;
+    for (size_t i = (b + 1) & mask; buckets[i].pid != 0; i = (i + 1) & mask) {
+        size_t home = bucketFor(buckets[i].pid);
+        // Move it if its home is not in (hole, i], cyclically.
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            buckets[hole] = buckets[i];
+            hole = i;
+        }
+    }
+    buckets[hole].pid = 0;
+}
+
+void ProcessTable::rehash(size_t capacity) {
+    std::vector<Bucket> old;
+    old.swap(buckets);
+    buckets.assign(capacity, Bucket{0, 0});
+    shift = 64;
+    for (size_t c = capacity; c > 1; c >>= 1) {
+        --shift;
+    }
+
+    size_t mask = capacity - 1;
+    for (const Bucket& bucket : old) {
+        if (bucket.pid == 0) {
+            continue;
+        }
+        size_t b = bucketFor(bucket.pid);
+        while (buckets[b].pid != 0) {
+            b = (b + 1) & mask;
+        }
+        buckets[b] = bucket;
+    }
+}
+
+void ProcessTable::reserve(size_t n) {
+    entries.reserve(n);
+    size_t capacity = buckets.size();
+    while (capacity < 2 * n) {
+        capacity *= 2;
+    }
+    if (capacity != buckets.size()) {
+        rehash(capacity);
+    }
+}
+
+ProcessInfo& ProcessTable::insert(pid_t pid, const std::string& command) {
+    size_t b = lookup(pid);
+    if (b != SIZE_MAX) {
+        ProcessInfo& info = entries[buckets[b].slot];
+        info.command = command;
+        info.state = ProcessState::RUNNING;
+        info.exitStatus = -1;
+        info.usage = ProcessUsage();
+        return info;
+    }
+
+    if (2 * (entries.size() + 1) > buckets.size()) {
+        rehash(2 * buckets.size());
+    }
+    size_t mask = buckets.size() - 1;
+    b = bucketFor(pid);
+    while (buckets[b].pid != 0) {
+        b = (b + 1) & mask;
+    }
+    buckets[b] = Bucket{pid, static_cast<uint32_t>(entries.size())};
+    entries.push_back(ProcessInfo{pid, command, ProcessState::RUNNING, -1, ProcessUsage()});
+    return entries.back();
+}
+
+ProcessInfo* ProcessTable::find(pid_t pid) {
+    size_t b = lookup(pid);
+    return b == SIZE_MAX ? nullptr : &entries[buckets[b].slot];
+}
+
+const ProcessInfo* ProcessTable::find(pid_t pid) const {
+    size_t b = lookup(pid);
+    return b == SIZE_MAX ? nullptr : &entries[buckets[b].slot];
+}
+
+bool ProcessTable::setState(pid_t pid, ProcessState state) {
+    ProcessInfo* info = find(pid);
+    if (!info) {
+        return false;
+    }
+    info->state = state;
+    return true;
+}
+
+// Fills the hole at 'slot' with the last entry and fixes its bucket.
+void ProcessTable::removeLive(size_t slot) {
+    size_t last = entries.size() - 1;
+    if (slot != last) {
+        entries[slot] = std::move(entries[last]);
+        buckets[lookup(entries[slot].pid)].slot = static_cast<uint32_t>(slot);
+    }
+    entries.pop_back();
+}
+
+bool ProcessTable::markExited(pid_t pid, int status, ProcessInfo* out) {
+    size_t b = lookup(pid);
+    if (b == SIZE_MAX) {
+        return false;
+    }
+    size_t slot = buckets[b].slot;
+    eraseBucket(b);
+
+    ProcessInfo& info = entries[slot];
+    info.state = ProcessState::TERMINATED;
+    info.exitStatus = status;
+    if (out) {
+        *out = info;
+    }
+
+    if (!history.empty()) {
+        // Reuses the overwritten entry's string buffer.
+        ProcessInfo& h = history[historyNext];
+        h.pid = info.pid;
+        h.command.swap(info.command);
+        h.state = info.state;
+        h.exitStatus = info.exitStatus;
+        h.usage = info.usage;
+        historyNext = (historyNext + 1) % history.size();
+        if (historyCount < history.size()) {
+            ++historyCount;
+        }
+    }
+
+    removeLive(slot);
+    return true;
+}
+
+const ProcessInfo* ProcessTable::findExited(pid_t pid) const {
+    size_t cap = history.size();
+    for (size_t i = 1; i <= historyCount; ++i) {
+        const ProcessInfo& info = history[(historyNext + cap - i) % cap];
+        if (info.pid == pid) {
+            return &info;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,140 @@
+#ifndef PROCESS_TABLE_H
+#define PROCESS_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+enum class ProcessState {
+    RUNNING,
+    STOPPED,
+    TERMINATING,    // signalled by terminateProcess(), not reaped yet
+    TERMINATED
+};
+
+// Resources a child has used. While it runs the figures come from the
+// ProcessManager sampler (/proc/<pid>/stat, /status and /io); when it is
+// reaped, from its rusage, which is exact.
+struct ProcessUsage {
+    uint64_t userTimeUs = 0;
+    uint64_t systemTimeUs = 0;
+    uint64_t rssBytes = 0;              // at the last sample; 0 once exited
+    uint64_t peakRssBytes = 0;          // VmHWM while running; ru_maxrss at exit
+    uint64_t minorFaults = 0;
+    uint64_t majorFaults = 0;
+    uint64_t voluntarySwitches = 0;     // context switches, from /status
+    uint64_t involuntarySwitches = 0;   // while running
+    uint64_t readBytes = 0;             // from / to storage (read_bytes,
+    uint64_t writeBytes = 0;            // write_bytes; ru_in/oublock at exit)
+    uint64_t readChars = 0;             // through read()/write() and friends,
+    uint64_t writeChars = 0;            // page cache included (sampled only)
+    uint32_t samples = 0;               // sampler passes that saw the child
+    bool final = false;                 // filled in from rusage at exit
+};
+
+struct ProcessInfo {
+    pid_t pid;
+    std::string command;
+    ProcessState state;
+    int exitStatus;     // waitpid() status once TERMINATED, -1 before
+                        // (and if the child was reaped by someone else)
+    ProcessUsage usage;
+};
+
+/*
+ * ProcessTable:
+ * The children a ProcessManager is tracking, keyed by pid.
+ *
+ * Live entries sit in one dense array (removal moves the last entry into
+ * the hole), and an open-addressing hash index maps each pid to its
+ * position, so insert, lookup, state changes and removal are O(1) and
+ * iterating the live children walks contiguous memory.
+ *
+ * An exited child leaves the live array for a fixed-size ring of recent
+ * exits, kept for post-mortem; the oldest exit is overwritten once the
+ * ring is full. A table with N live children therefore never holds more
+ * than N + historySize entries however many children came and went.
+ *
+ * Not thread-safe; ProcessManager locks around it. Pointers returned by
+ * find() stay valid until the next insert() or remove.
+ */
+class ProcessTable {
+public:
+    static const size_t DEFAULT_HISTORY = 1024;
+
+    explicit ProcessTable(size_t historySize = DEFAULT_HISTORY);
+
+    // Adds a RUNNING entry; replaces a live entry with the same pid.
+    ProcessInfo& insert(pid_t pid, const std::string& command);
+
+    // Live entry for 'pid', or null
+    ProcessInfo* find(pid_t pid);
+    const ProcessInfo* find(pid_t pid) const;
+
+    bool setState(pid_t pid, ProcessState state);
+
+    // Records the exit of a live child and moves it to the history ring.
+    // 'out' (optional) gets the final entry. False if 'pid' is not live.
+    bool markExited(pid_t pid, int status, ProcessInfo* out = nullptr);
+
+    // Most recent exit of 'pid' still in the history ring, or null.
+    // Linear in historySize; meant for post-mortem, not hot paths.
+    const ProcessInfo* findExited(pid_t pid) const;
+
+    size_t size() const { return entries.size(); }
+    size_t exitedCount() const { return historyCount; }
+    size_t historyCapacity() const { return history.size(); }
+
+    // Calls fn(const ProcessInfo&) for every live entry. The table must
+    // not be modified from 'fn'.
+    template <typename F>
+    void forEach(F&& fn) const;
+
+    // Same for the history ring, oldest exit first
+    template <typename F>
+    void forEachExited(F&& fn) const;
+
+    // Preallocates room for 'n' live entries.
+    void reserve(size_t n);
+
+private:
+    // Hash index bucket; pid 0 marks an empty one
+    struct Bucket {
+        pid_t pid;
+        uint32_t slot;      // position in 'entries'
+    };
+
+    size_t bucketFor(pid_t pid) const;
+    size_t lookup(pid_t pid) const;     // bucket holding 'pid', or SIZE_MAX
+    void eraseBucket(size_t b);
+    void rehash(size_t capacity);
+    void removeLive(size_t slot);
+
+    std::vector<ProcessInfo> entries;   // live children, dense
+    std::vector<Bucket> buckets;        // power of two, at most half full
+    unsigned shift;                     // 64 - log2(buckets.size())
+
+    std::vector<ProcessInfo> history;   // ring of recent exits
+    size_t historyNext;                 // where the next exit goes
+    size_t historyCount;
+};
+
+template <typename F>
+void ProcessTable::forEach(F&& fn) const {
+    for (const ProcessInfo& info : entries) {
+        fn(info);
+    }
+}
+
+template <typename F>
+void ProcessTable::forEachExited(F&& fn) const {
+    size_t cap = history.size();
+    size_t first = (historyNext + cap - historyCount) % (cap ? cap : 1);
+    for (size_t i = 0; i < historyCount; ++i) {
+        fn(history[(first + i) % cap]);
+    }
+}
+
+#endif
@@ -0,0 +1,229 @@
+#include "shared_segment.h"
+#include "ipc_manager.h"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <utility>
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+static size_t roundUp(size_t n, size_t unit) {
+    return (n + unit - 1) / unit * unit;
+}
+
+size_t SharedSegment::hugePageSize() {
+    static const size_t size = [] {
+        std::ifstream meminfo("/proc/meminfo");
+        std::string key;
+        size_t kb;
+        while (meminfo >> key >> kb) {
+            if (key == "Hugepagesize:") {
+                return kb * 1024;
+            }
+            meminfo.ignore(256, '\n');
+        }
+        return size_t(2) << 20;
+    }();
+    return size;
+}
+
+SharedSegment::SharedSegment()
+    : addr(nullptr), length(0), fd(-1), owner(false), huge(false), locked_(false) {}
+
+SharedSegment::~SharedSegment() {
+    close();
+}
+
+SharedSegment::SharedSegment(SharedSegment&& other) noexcept : SharedSegment() {
+    *this = std::move(other);
+}
+
+SharedSegment& SharedSegment::operator=(SharedSegment&& other) noexcept {
+    if (this != &other) {
+        close();
+        std::swap(addr, other.addr);
+        std::swap(length, other.length);
+        std::swap(fd, other.fd);
+        std::swap(name_, other.name_);
+        std::swap(path, other.path);
+        std::swap(owner, other.owner);
+        std::swap(huge, other.huge);
+        std::swap(locked_, other.locked_);
+    }
+    return *this;
+}
+
+bool SharedSegment::create(const std::string& name, size_t size, const SegmentOptions& options) {
+    close();
+    name_ = name;
+    owner = true;
+    if (!openBacking(name, true, size, options)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool SharedSegment::open(const std::string& name, const SegmentOptions& options) {
+    close();
+    name_ = name;
+    size_t size = 0;
+    if (!openBacking(name, false, size, options)) {
+        reset();
+        return false;
+    }
+    return true;
+}
+
+bool SharedSegment::createAnonymous(size_t size, const SegmentOptions& options) {
+    close();
+    if (options.hugePages == HugePages::EXPLICIT) {
+        if (mapBacking(roundUp(size, hugePageSize()), options, MAP_ANONYMOUS | MAP_HUGETLB)) {
+            huge = true;
+            return true;
+        }
+        SegmentOptions fallback = options;
+        fallback.hugePages = HugePages::TRANSPARENT;
+        return mapBacking(size, fallback, MAP_ANONYMOUS);
+    }
+    return mapBacking(size, options, MAP_ANONYMOUS);
+}
+
+// Opens (or creates) the file behind the segment and maps it. EXPLICIT
+// tries a hugetlbfs file first and otherwise uses POSIX shm with THP.
+bool SharedSegment::openBacking(const std::string& name, bool create, size_t& size,
+                                const SegmentOptions& options) {
+    SegmentOptions shmOptions = options;
+    if (options.hugePages == HugePages::EXPLICIT) {
+        shmOptions.hugePages = HugePages::TRANSPARENT;
+
+        std::string hugePath = options.hugetlbfsDir + name;
+        fd = ::open(hugePath.c_str(), O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0), 0666);
+        if (fd != -1) {
+            struct stat st;
+            bool sized;
+            if (create) {
+                size = roundUp(size, hugePageSize());
+                sized = ftruncate(fd, size) == 0;
+            } else {
+                sized = fstat(fd, &st) == 0;
+                size = sized ? static_cast<size_t>(st.st_size) : 0;
+            }
+            if (sized && mapBacking(size, options, 0)) {
+                path = hugePath;
+                huge = true;
+                return true;
+            }
+            ::close(fd);
+            fd = -1;
+            if (create) {
+                unlink(hugePath.c_str());
+            }
+        }
+    }
+
+    if (create) {
+        fd = IPCManager::createSharedMemory(name, size);
+        if (fd == -1) {
+            return false;
+        }
+    } else {
+        fd = shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0666);
+        struct stat st;
+        if (fd == -1 || fstat(fd, &st) == -1) {
+            perror("open shared segment failed");
+            return false;
+        }
+        size = static_cast<size_t>(st.st_size);
+    }
+    return mapBacking(size, shmOptions, 0);
+}
+
+bool SharedSegment::mapBacking(size_t size, const SegmentOptions& options, int extraFlags) {
+    if (size == 0) {
+        fprintf(stderr, "shared segment '%s' is empty\n", name_.c_str());
+        return false;
+    }
+
+    // MAP_POPULATE would fault the range in with small pages before the
+    // THP hint is given, so in that case populate after madvise() instead.
+    bool transparent = options.hugePages == HugePages::TRANSPARENT;
+    bool populate = options.prefault == Prefault::POPULATE && !transparent;
+    int flags = MAP_SHARED | extraFlags | (populate ? MAP_POPULATE : 0);
+
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, fd, 0);
+    if (p == MAP_FAILED) {
+        // Expected when no huge pages are reserved; the caller falls back.
+        if (!(flags & MAP_HUGETLB) && options.hugePages != HugePages::EXPLICIT) {
+            perror("mmap shared segment failed");
+        }
+        return false;
+    }
+    addr = p;
+    length = size;
+
+    if (transparent && madvise(addr, length, MADV_HUGEPAGE) == -1 && errno != EINVAL) {
+        perror("madvise(MADV_HUGEPAGE) failed");
+    }
+    if (options.prefault == Prefault::TOUCH
+        || (options.prefault == Prefault::POPULATE && transparent)) {
+        prefault();
+    }
+    if (options.lock) {
+        if (mlock(addr, length) == 0) {
+            locked_ = true;
+        } else {
+            perror("mlock shared segment failed");
+        }
+    }
+    return true;
+}
+
+// Write-faults every page without changing its contents, so it is also
+// safe on a segment other processes are already using.
+void SharedSegment::prefault() {
+    if (madvise(addr, length, MADV_POPULATE_WRITE) == 0) {
+        return;
+    }
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    char* base = static_cast<char*>(addr);
+    for (size_t off = 0; off < length; off += page) {
+        __atomic_fetch_add(base + off, 0, __ATOMIC_RELAXED);
+    }
+}
+
+void SharedSegment::close() {
+    if (owner && !name_.empty()) {
+        if (!path.empty()) {
+            unlink(path.c_str());
+        } else {
+            IPCManager::unlinkSharedMemory(name_);
+        }
+    }
+    reset();
+}
+
+void SharedSegment::reset() {
+    if (addr) {
+        munmap(addr, length);
+    }
+    if (fd != -1) {
+        ::close(fd);
+    }
+    addr = nullptr;
+    length = 0;
+    fd = -1;
+    name_.clear();
+    path.clear();
+    owner = false;
+    huge = false;
+    locked_ = false;
+}
@@ -0,0 +1,108 @@
+#ifndef SHARED_SEGMENT_H
+#define SHARED_SEGMENT_H
+
+#include <cstddef>
+#include <string>
+
+enum class HugePages {
+    NONE,          // regular pages
+    TRANSPARENT,   // madvise(MADV_HUGEPAGE); the kernel may back the range
+                   // with huge pages (shmem_enabled must allow it)
+    EXPLICIT       // hugetlbfs / MAP_HUGETLB; size rounds up to the huge page
+                   // size and falls back to TRANSPARENT if none are reserved
+};
+
+enum class Prefault {
+    NONE,          // fault pages in lazily on first touch
+    POPULATE,      // MAP_POPULATE: the kernel faults everything in at mmap()
+    TOUCH          // after mapping, write-fault every page (MADV_POPULATE_WRITE,
+                   // or a data-preserving touch loop on older kernels)
+};
+
+struct SegmentOptions {
+    HugePages hugePages = HugePages::NONE;
+    Prefault prefault = Prefault::NONE;
+
+    // mlock() the mapping so it is never paged out. Failure (usually
+    // RLIMIT_MEMLOCK) is reported but does not fail the mapping; check
+    // locked().
+    bool lock = false;
+
+    // Where EXPLICIT huge page segments live; a hugetlbfs mount
+    std::string hugetlbfsDir = "/dev/hugepages";
+};
+
+/*
+ * SharedSegment:
+ * Owns one shared memory mapping and everything behind it. The mapping
+ * is munmap()ed and the descriptor closed on destruction; a segment made
+ * with create() is also unlinked then, unless release() handed the name
+ * over to somebody else.
+ *
+ * Large segments map with few TLB entries when backed by huge pages, and
+ * pre-faulting moves the page-fault cost of the first pass over the data
+ * to setup time.
+ *
+ *   create()          named segment, like IPCManager::createSharedMemory
+ *   open()            segment another process created (same options)
+ *   createAnonymous() no name; shared with children through fork()
+ */
+class SharedSegment {
+public:
+    SharedSegment();
+    ~SharedSegment();
+
+    SharedSegment(SharedSegment&& other) noexcept;
+    SharedSegment& operator=(SharedSegment&& other) noexcept;
+
+    SharedSegment(const SharedSegment&) = delete;
+    SharedSegment& operator=(const SharedSegment&) = delete;
+
+    // Creates (or truncates and reuses) the segment 'name' ("/something").
+    bool create(const std::string& name, size_t size, const SegmentOptions& options = SegmentOptions());
+
+    // Maps an existing segment; the size comes from the segment.
+    bool open(const std::string& name, const SegmentOptions& options = SegmentOptions());
+
+    bool createAnonymous(size_t size, const SegmentOptions& options = SegmentOptions());
+
+    // Unmaps, closes, and unlinks if this object created the segment.
+    void close();
+
+    // Keep the name alive after close(), e.g. for processes that have yet
+    // to open it.
+    void release() { owner = false; }
+
+    bool isOpen() const { return addr != nullptr; }
+    void* data() const { return addr; }
+    size_t size() const { return length; }
+    const std::string& name() const { return name_; }
+
+    template <typename T>
+    T* as() const { return static_cast<T*>(addr); }
+
+    // Backed by explicit huge pages. False after a fallback to TRANSPARENT,
+    // which is only a hint the kernel may or may not follow.
+    bool hugePages() const { return huge; }
+    bool locked() const { return locked_; }
+
+    // Huge page size of the system (Hugepagesize in /proc/meminfo)
+    static size_t hugePageSize();
+
+private:
+    bool openBacking(const std::string& name, bool create, size_t& size, const SegmentOptions& options);
+    bool mapBacking(size_t size, const SegmentOptions& options, int extraFlags);
+    void prefault();
+    void reset();
+
+    void* addr;
+    size_t length;
+    int fd;
+    std::string name_;
+    std::string path;     // hugetlbfs file, empty for POSIX shm
+    bool owner;
+    bool huge;
+    bool locked_;
+};
+
+#endif
@@ -0,0 +1,196 @@
+#include "shm_allocator.h"
+
+#include <cstdio>
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "allocator state is shared between processes and must be lock-free");
+
+static const uint32_t ALLOCATOR_MAGIC = 0x534c4142;   // "SLAB"
+static const uint32_t BLOCK_MAGIC = 0x424c4b30;       // "BLK0"
+
+// Free list heads pack a block offset with an ABA tag.
+static const unsigned OFFSET_BITS = 40;
+static const uint64_t OFFSET_MASK = (uint64_t(1) << OFFSET_BITS) - 1;
+
+static inline uint64_t tagged(uint64_t offset, uint64_t oldHead) {
+    return offset | (((oldHead >> OFFSET_BITS) + 1) << OFFSET_BITS);
+}
+
+// One free list per cache line: different size classes do not contend.
+struct alignas(64) FreeList {
+    std::atomic<uint64_t> head;
+};
+
+struct ShmAllocator::Header {
+    std::atomic<uint32_t> magic;   // set last by format()
+    uint32_t numClasses;
+    uint64_t size;
+    uint64_t dataStart;
+    std::atomic<uint64_t> root;
+    alignas(64) std::atomic<uint64_t> bump;
+    FreeList freeLists[NUM_CLASSES];
+};
+
+// In front of every block
+struct BlockHeader {
+    uint32_t magic;
+    uint32_t cls;
+    uint64_t reserved;
+};
+
+static_assert(sizeof(BlockHeader) == ShmAllocator::BLOCK_HEADER, "block header size");
+static_assert((ShmAllocator::MIN_BLOCK << (ShmAllocator::NUM_CLASSES - 1)) == ShmAllocator::MAX_BLOCK,
+              "size classes must end at MAX_BLOCK");
+
+ShmAllocator::ShmAllocator() : hdr(nullptr), base(nullptr) {}
+
+bool ShmAllocator::format(void* region, size_t size) {
+    hdr = nullptr;
+    base = nullptr;
+    size_t start = (sizeof(Header) + 63) & ~size_t(63);
+    if (size <= start + MIN_BLOCK || size > OFFSET_MASK) {
+        fprintf(stderr, "region of %zu bytes cannot hold a shared allocator\n", size);
+        return false;
+    }
+
+    Header* h = static_cast<Header*>(region);
+    h->magic.store(0, std::memory_order_relaxed);
+    h->numClasses = NUM_CLASSES;
+    h->size = size;
+    h->dataStart = start;
+    h->root.store(0, std::memory_order_relaxed);
+    h->bump.store(start, std::memory_order_relaxed);
+    for (FreeList& list : h->freeLists) {
+        list.head.store(0, std::memory_order_relaxed);
+    }
+    h->magic.store(ALLOCATOR_MAGIC, std::memory_order_release);
+
+    hdr = h;
+    base = static_cast<char*>(region);
+    return true;
+}
+
+bool ShmAllocator::attach(void* region, size_t size) {
+    hdr = nullptr;
+    base = nullptr;
+    Header* h = static_cast<Header*>(region);
+    if (size < sizeof(Header)
+        || h->magic.load(std::memory_order_acquire) != ALLOCATOR_MAGIC
+        || h->numClasses != NUM_CLASSES
+        || h->size != size) {
+        fprintf(stderr, "region does not hold a shared allocator\n");
+        return false;
+    }
+    hdr = h;
+    base = static_cast<char*>(region);
+    return true;
+}
+
+size_t ShmAllocator::classFor(size_t bytes) {
+    size_t need = bytes + BLOCK_HEADER;
+    size_t cls = 0;
+    while ((MIN_BLOCK << cls) < need) {
+        ++cls;
+    }
+    return cls;
+}
+
+// The link of a free block lives in its payload; read racily by pop(),
+// so always accessed atomically.
+std::atomic<uint64_t>& ShmAllocator::nextOf(uint64_t block) const {
+    return *reinterpret_cast<std::atomic<uint64_t>*>(base + block + BLOCK_HEADER);
+}
+
+uint64_t ShmAllocator::pop(size_t cls) {
+    std::atomic<uint64_t>& head = hdr->freeLists[cls].head;
+    uint64_t cur = head.load(std::memory_order_acquire);
+    while (true) {
+        uint64_t block = cur & OFFSET_MASK;
+        if (!block) {
+            return 0;
+        }
+        // 'block' may be popped and reused by someone else right now; the
+        // tag makes the CAS fail if so, whatever this load returned.
+        uint64_t next = nextOf(block).load(std::memory_order_relaxed);
+        if (head.compare_exchange_weak(cur, tagged(next, cur),
+                                       std::memory_order_acquire,
+                                       std::memory_order_acquire)) {
+            return block;
+        }
+    }
+}
+
+void ShmAllocator::push(size_t cls, uint64_t block) {
+    std::atomic<uint64_t>& head = hdr->freeLists[cls].head;
+    uint64_t cur = head.load(std::memory_order_relaxed);
+    do {
+        nextOf(block).store(cur & OFFSET_MASK, std::memory_order_relaxed);
+    } while (!head.compare_exchange_weak(cur, tagged(block, cur),
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed));
+}
+
+uint64_t ShmAllocator::carve(size_t blockSize) {
+    uint64_t cur = hdr->bump.load(std::memory_order_relaxed);
+    do {
+        if (cur + blockSize > hdr->size) {
+            return 0;
+        }
+    } while (!hdr->bump.compare_exchange_weak(cur, cur + blockSize, std::memory_order_relaxed));
+    return cur;
+}
+
+uint64_t ShmAllocator::allocate(size_t bytes) {
+    if (!hdr || bytes > MAX_ALLOCATION) {
+        return 0;
+    }
+    size_t cls = classFor(bytes);
+    uint64_t block = pop(cls);
+    if (!block) {
+        block = carve(MIN_BLOCK << cls);
+        if (!block) {
+            return 0;
+        }
+    }
+    BlockHeader* bh = reinterpret_cast<BlockHeader*>(base + block);
+    bh->magic = BLOCK_MAGIC;
+    bh->cls = static_cast<uint32_t>(cls);
+    return block + BLOCK_HEADER;
+}
+
+void ShmAllocator::deallocate(uint64_t offset) {
+    if (!hdr || !offset) {
+        return;
+    }
+    uint64_t block = offset - BLOCK_HEADER;
+    BlockHeader* bh = reinterpret_cast<BlockHeader*>(base + block);
+    if (offset < hdr->dataStart + BLOCK_HEADER || offset >= hdr->size
+        || bh->magic != BLOCK_MAGIC || bh->cls >= NUM_CLASSES) {
+        fprintf(stderr, "deallocate: offset %llu is not an allocated block\n",
+                static_cast<unsigned long long>(offset));
+        return;
+    }
+    bh->magic = 0;
+    push(bh->cls, block);
+}
+
+size_t ShmAllocator::usableSize(uint64_t offset) const {
+    const BlockHeader* bh = reinterpret_cast<const BlockHeader*>(base + offset - BLOCK_HEADER);
+    return (MIN_BLOCK << bh->cls) - BLOCK_HEADER;
+}
+
+void ShmAllocator::setRoot(uint64_t offset) {
+    hdr->root.store(offset, std::memory_order_release);
+}
+
+uint64_t ShmAllocator::root() const {
+    return hdr->root.load(std::memory_order_acquire);
+}
+
+size_t ShmAllocator::used() const {
+    return hdr ? hdr->bump.load(std::memory_order_relaxed) - hdr->dataStart : 0;
+}
+
+size_t ShmAllocator::capacity() const {
+    return hdr ? hdr->size - hdr->dataStart : 0;
+}
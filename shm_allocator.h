@@ -0,0 +1,128 @@
+#ifndef SHM_ALLOCATOR_H
+#define SHM_ALLOCATOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * OffsetPtr<T>:
+ * Pointer that can be stored inside shared memory. It holds the distance
+ * from its own address to the target, so it stays valid in every process
+ * no matter where each one mapped the segment. Both the OffsetPtr and the
+ * object must live in the same mapping. Null is a distance of zero.
+ */
+template <typename T>
+class OffsetPtr {
+public:
+    OffsetPtr() : diff(0) {}
+    OffsetPtr(T* p) { set(p); }
+    OffsetPtr(const OffsetPtr& other) { set(other.get()); }
+
+    OffsetPtr& operator=(const OffsetPtr& other) {
+        set(other.get());
+        return *this;
+    }
+    OffsetPtr& operator=(T* p) {
+        set(p);
+        return *this;
+    }
+
+    T* get() const {
+        return diff ? reinterpret_cast<T*>(reinterpret_cast<intptr_t>(this) + diff) : nullptr;
+    }
+    T* operator->() const { return get(); }
+    T& operator*() const { return *get(); }
+    explicit operator bool() const { return diff != 0; }
+
+private:
+    void set(T* p) {
+        diff = p ? reinterpret_cast<intptr_t>(p) - reinterpret_cast<intptr_t>(this) : 0;
+    }
+
+    intptr_t diff;
+};
+
+/*
+ * ShmAllocator:
+ * Slab allocator whose entire state lives inside a shared memory region,
+ * so every process that maps the region can allocate and free in it
+ * concurrently. Blocks are addressed by their offset from the start of
+ * the region (0 is never a valid block), which means the same value in
+ * every process; at() turns an offset into a local pointer.
+ *
+ * Requests are rounded up to power-of-two size classes from 32 bytes to
+ * 1 MiB (16 bytes of each block are its header). Every class has a
+ * lock-free free list (a Treiber stack whose head carries an ABA tag);
+ * blocks that were never used are carved from a bump pointer. Freed
+ * blocks go back to their class and are never returned to the region.
+ *
+ * Nothing is ever locked, so a process that dies in the middle of an
+ * allocation can at worst leak that one block.
+ *
+ * The region must be 16-byte aligned (any mapping is) and under 1 TiB.
+ */
+class ShmAllocator {
+public:
+    static const size_t MIN_BLOCK = 32;
+    static const size_t MAX_BLOCK = size_t(1) << 20;
+    static const size_t NUM_CLASSES = 16;          // MIN_BLOCK << 0 .. 15
+    static const size_t BLOCK_HEADER = 16;
+
+    // Largest size allocate() accepts
+    static const size_t MAX_ALLOCATION = MAX_BLOCK - BLOCK_HEADER;
+
+    ShmAllocator();
+
+    // Lays out an empty allocator over [base, base + size). Call once,
+    // from the process that created the region, before anyone attaches.
+    bool format(void* base, size_t size);
+
+    // Uses an allocator another process formatted in this region.
+    bool attach(void* base, size_t size);
+
+    bool isAttached() const { return hdr != nullptr; }
+
+    // Offset of a block of at least 'bytes' usable bytes (16-byte
+    // aligned), or 0 if the request is too large or the region is full.
+    uint64_t allocate(size_t bytes);
+
+    // Returns a block from allocate(); any process may free it.
+    void deallocate(uint64_t offset);
+
+    // Usable bytes of an allocated block
+    size_t usableSize(uint64_t offset) const;
+
+    void* at(uint64_t offset) const { return offset ? base + offset : nullptr; }
+
+    template <typename T>
+    T* get(uint64_t offset) const { return static_cast<T*>(at(offset)); }
+
+    uint64_t offsetOf(const void* p) const {
+        return p ? static_cast<uint64_t>(static_cast<const char*>(p) - base) : 0;
+    }
+
+    // A well-known slot for the offset of the first shared object, so
+    // attaching processes know where to start.
+    void setRoot(uint64_t offset);
+    uint64_t root() const;
+
+    // Bytes of the region handed out by the bump pointer so far (blocks
+    // sitting on free lists count as used)
+    size_t used() const;
+    size_t capacity() const;
+
+private:
+    struct Header;
+
+    static size_t classFor(size_t bytes);
+    uint64_t pop(size_t cls);
+    void push(size_t cls, uint64_t block);
+    uint64_t carve(size_t blockSize);
+    std::atomic<uint64_t>& nextOf(uint64_t block) const;
+
+    Header* hdr;
+    char* base;
+};
+
+#endif
@@ -0,0 +1,369 @@
+#include "shm_ring_channel.h"
+#include "futex_event.h"
+#include "ipc_manager.h"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstring>
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "ring indices are shared between processes and must be lock-free");
+
+static const uint32_t CHANNEL_MAGIC = 0x52494e47;   // "RING"
+static const size_t RECORD_HEADER = 8;
+
+// Lives at the start of the segment. Each index gets its own cache line:
+// producers hammer the heads, the consumer hammers the tail.
+struct ShmRingChannel::Control {
+    std::atomic<uint32_t> magic;   // set last by create()
+    uint32_t mode;
+    uint64_t capacity;
+    alignas(64) std::atomic<uint64_t> reserveHead;   // claimed by producers
+    alignas(64) std::atomic<uint64_t> publishHead;   // committed, visible to the consumer
+    alignas(64) std::atomic<uint64_t> tail;          // released by the consumer
+    alignas(64) FutexEvent dataReady;                // consumer sleeps here
+    alignas(64) FutexEvent spaceFreed;               // producers sleep here
+};
+
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+static inline size_t alignRecord(size_t n) {
+    return (n + 7) & ~size_t(7);
+}
+
+ShmRingChannel::ShmRingChannel()
+    : ctl(nullptr), ring(nullptr), mask(0), mappedSize(0), readPos(0), readEnd(0) {}
+
+ShmRingChannel::~ShmRingChannel() {
+    close();
+}
+
+bool ShmRingChannel::create(const std::string& name, size_t capacity, Mode mode) {
+    close();
+
+    // Frame lengths are 32-bit
+    if (capacity > (size_t(1) << 31)) {
+        fprintf(stderr, "ring channel capacity %zu too large\n", capacity);
+        return false;
+    }
+    size_t cap = 64;
+    while (cap < capacity) {
+        cap <<= 1;
+    }
+    size_t size = sizeof(Control) + cap;
+
+    int fd = IPCManager::createSharedMemory(name, size);
+    if (fd == -1) {
+        return false;
+    }
+    bool ok = map(fd, size);
+    ::close(fd);
+    if (!ok) {
+        return false;
+    }
+
+    ctl->magic.store(0, std::memory_order_relaxed);
+    ctl->mode = static_cast<uint32_t>(mode);
+    ctl->capacity = cap;
+    ctl->reserveHead.store(0, std::memory_order_relaxed);
+    ctl->publishHead.store(0, std::memory_order_relaxed);
+    ctl->tail.store(0, std::memory_order_relaxed);
+    ctl->dataReady.seq.store(0, std::memory_order_relaxed);
+    ctl->dataReady.waiters.store(0, std::memory_order_relaxed);
+    ctl->spaceFreed.seq.store(0, std::memory_order_relaxed);
+    ctl->spaceFreed.waiters.store(0, std::memory_order_relaxed);
+    ctl->magic.store(CHANNEL_MAGIC, std::memory_order_release);
+
+    mask = cap - 1;
+    readPos = 0;
+    readEnd = 0;
+    return true;
+}
+
+bool ShmRingChannel::open(const std::string& name) {
+    close();
+
+    int fd = shm_open(name.c_str(), O_RDWR, 0666);
+    if (fd == -1) {
+        perror("shm_open failed");
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        perror("fstat failed");
+        ::close(fd);
+        return false;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size < sizeof(Control)) {
+        fprintf(stderr, "shared memory '%s' is not a ring channel\n", name.c_str());
+        ::close(fd);
+        return false;
+    }
+    bool ok = map(fd, size);
+    ::close(fd);
+    if (!ok) {
+        return false;
+    }
+
+    if (ctl->magic.load(std::memory_order_acquire) != CHANNEL_MAGIC
+        || sizeof(Control) + ctl->capacity != size) {
+        fprintf(stderr, "shared memory '%s' is not a ring channel\n", name.c_str());
+        close();
+        return false;
+    }
+
+    mask = ctl->capacity - 1;
+    readPos = ctl->tail.load(std::memory_order_acquire);
+    readEnd = readPos;
+    return true;
+}
+
+bool ShmRingChannel::map(int fd, size_t size) {
+    void* addr = IPCManager::mapSharedMemory(fd, size);
+    if (!addr) {
+        return false;
+    }
+    ctl = static_cast<Control*>(addr);
+    ring = static_cast<char*>(addr) + sizeof(Control);
+    mappedSize = size;
+    return true;
+}
+
+void ShmRingChannel::close() {
+    if (ctl) {
+        munmap(ctl, mappedSize);
+    }
+    ctl = nullptr;
+    ring = nullptr;
+    mask = 0;
+    mappedSize = 0;
+    readPos = 0;
+    readEnd = 0;
+}
+
+ShmRingChannel::Mode ShmRingChannel::mode() const {
+    return static_cast<Mode>(ctl->mode);
+}
+
+// Half the ring, so a record plus the padding in front of it always fits.
+size_t ShmRingChannel::maxMessageSize() const {
+    return ctl ? capacity() / 2 - RECORD_HEADER : 0;
+}
+
+void ShmRingChannel::writeHeader(uint64_t pos, uint32_t frame, uint32_t payload) {
+    char* header = ring + (pos & mask);
+    memcpy(header, &frame, sizeof(frame));
+    memcpy(header + sizeof(frame), &payload, sizeof(payload));
+}
+
+// Producer side
+
+bool ShmRingChannel::reserve(size_t length, Reservation& out) {
+    if (!ctl || length > maxMessageSize()) {
+        return false;
+    }
+
+    size_t frame = alignRecord(length + RECORD_HEADER);
+    size_t cap = capacity();
+    bool shared = ctl->mode == static_cast<uint32_t>(Mode::MPSC);
+
+    uint64_t head = ctl->reserveHead.load(std::memory_order_relaxed);
+    size_t skip;
+    while (true) {
+        size_t untilEnd = cap - (head & mask);
+        skip = frame <= untilEnd ? 0 : untilEnd;
+
+        uint64_t tail = ctl->tail.load(std::memory_order_acquire);
+        if (head + skip + frame - tail > cap) {
+            return false;
+        }
+        if (!shared) {
+            ctl->reserveHead.store(head + skip + frame, std::memory_order_relaxed);
+            break;
+        }
+        if (ctl->reserveHead.compare_exchange_weak(head, head + skip + frame,
+                                                   std::memory_order_relaxed,
+                                                   std::memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    if (skip) {
+        writeHeader(head, static_cast<uint32_t>(skip), PADDING);
+    }
+    uint64_t record = head + skip;
+    out.data = ring + (record & mask) + RECORD_HEADER;
+    out.capacity = frame - RECORD_HEADER;
+    out.start = head;
+    out.end = record + frame;
+    return true;
+}
+
+void ShmRingChannel::commit(const Reservation& r, size_t length) {
+    if (length > r.capacity) {
+        length = r.capacity;    // the consumer must never read past the record
+    }
+    size_t frame = r.capacity + RECORD_HEADER;
+    writeHeader(r.end - frame, static_cast<uint32_t>(frame), static_cast<uint32_t>(length));
+    publish(r.start, r.end);
+}
+
+void ShmRingChannel::cancel(const Reservation& r) {
+    size_t frame = r.capacity + RECORD_HEADER;
+    writeHeader(r.end - frame, static_cast<uint32_t>(frame), PADDING);
+    publish(r.start, r.end);
+}
+
+// Makes [start, end) visible. With several producers the publish index
+// moves in reservation order, so wait for whoever reserved just before us.
+void ShmRingChannel::publish(uint64_t start, uint64_t end) {
+    if (ctl->mode == static_cast<uint32_t>(Mode::MPSC)) {
+        int spins = 0;
+        while (ctl->publishHead.load(std::memory_order_acquire) != start) {
+            if (++spins < 1000) {
+                cpuRelax();
+            } else {
+                sched_yield();
+            }
+        }
+    }
+    ctl->publishHead.store(end, std::memory_order_release);
+    ctl->dataReady.notify(1);
+}
+
+bool ShmRingChannel::send(const void* data, size_t length) {
+    Reservation r;
+    if (!reserve(length, r)) {
+        return false;
+    }
+    memcpy(r.data, data, length);
+    commit(r, length);
+    return true;
+}
+
+// Consumer side
+
+bool ShmRingChannel::read(Message& out) {
+    if (!ctl) {
+        return false;
+    }
+
+    uint64_t pos = readPos;
+    uint64_t head = ctl->publishHead.load(std::memory_order_acquire);
+    while (pos < head) {
+        uint32_t frame;
+        uint32_t payload;
+        const char* header = ring + (pos & mask);
+        memcpy(&frame, header, sizeof(frame));
+        memcpy(&payload, header + sizeof(frame), sizeof(payload));
+
+        if (payload != PADDING) {
+            out.data = header + RECORD_HEADER;
+            out.length = payload;
+            out.next = pos + frame;
+            readPos = out.next;
+            readEnd = out.next;
+            return true;
+        }
+        pos += frame;
+    }
+
+    // Only padding: free it now if nothing read earlier is still held,
+    // otherwise release() frees it along with the last message read.
+    if (pos != readPos) {
+        if (ctl->tail.load(std::memory_order_relaxed) == readEnd) {
+            ctl->tail.store(pos, std::memory_order_release);
+            ctl->spaceFreed.notify();
+        }
+        readPos = pos;
+    }
+    return false;
+}
+
+void ShmRingChannel::release(const Message& msg) {
+    // Padding skipped since the last message read goes with it.
+    uint64_t tail = msg.next == readEnd ? readPos : msg.next;
+    ctl->tail.store(tail, std::memory_order_release);
+    ctl->spaceFreed.notify();
+}
+
+bool ShmRingChannel::receive(std::string& out) {
+    Message msg;
+    if (!read(msg)) {
+        return false;
+    }
+    out.assign(msg.data, msg.length);
+    release(msg);
+    return true;
+}
+
+bool ShmRingChannel::empty() const {
+    return !ctl || ctl->publishHead.load(std::memory_order_acquire) == readPos;
+}
+
+// Blocking
+
+// Same arithmetic as reserve(), without claiming anything.
+bool ShmRingChannel::fits(size_t length) const {
+    size_t frame = alignRecord(length + RECORD_HEADER);
+    uint64_t head = ctl->reserveHead.load(std::memory_order_relaxed);
+    size_t untilEnd = capacity() - (head & mask);
+    size_t skip = frame <= untilEnd ? 0 : untilEnd;
+    uint64_t tail = ctl->tail.load(std::memory_order_acquire);
+    return head + skip + frame - tail <= capacity();
+}
+
+bool ShmRingChannel::waitForData(int timeoutMs) {
+    if (!ctl) {
+        return false;
+    }
+    timespec deadline;
+    if (timeoutMs >= 0) {
+        deadline = futexDeadline(timeoutMs);
+    }
+
+    while (empty()) {
+        uint32_t token = ctl->dataReady.prepareWait();
+        if (!empty()) {
+            ctl->dataReady.cancelWait();
+            break;
+        }
+        if (!ctl->dataReady.wait(token, timeoutMs >= 0 ? &deadline : nullptr)) {
+            return !empty();
+        }
+    }
+    return true;
+}
+
+bool ShmRingChannel::waitForSpace(size_t length, int timeoutMs) {
+    if (!ctl || length > maxMessageSize()) {
+        return false;
+    }
+    timespec deadline;
+    if (timeoutMs >= 0) {
+        deadline = futexDeadline(timeoutMs);
+    }
+
+    while (!fits(length)) {
+        uint32_t token = ctl->spaceFreed.prepareWait();
+        if (fits(length)) {
+            ctl->spaceFreed.cancelWait();
+            break;
+        }
+        if (!ctl->spaceFreed.wait(token, timeoutMs >= 0 ? &deadline : nullptr)) {
+            return fits(length);
+        }
+    }
+    return true;
+}
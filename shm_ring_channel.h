@@ -0,0 +1,163 @@
+#ifndef SHM_RING_CHANNEL_H
+#define SHM_RING_CHANNEL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+ * ShmRingChannel:
+ * Message channel over a POSIX shared memory segment, for processes that
+ * map the same name. The segment holds a small control block followed by
+ * a power-of-two byte ring of variable-length records:
+ *
+ *   [frame length:4][payload length:4][payload ... padded to 8 bytes]
+ *
+ * A record never wraps; when it would not fit before the end of the ring
+ * the producer writes a padding record and starts over at offset 0.
+ *
+ * Producers write in place: reserve() hands out a pointer into the
+ * segment, commit() publishes it. The consumer reads in place with read()
+ * and frees the space with release(). Neither side makes a system call;
+ * a full or empty ring is reported to the caller, who can block in
+ * waitForData() / waitForSpace(). Those sleep on futexes inside the
+ * segment, and commit() / release() only enter the kernel to wake a
+ * side that is actually asleep.
+ *
+ *   SPSC: one producer process/thread, one consumer
+ *   MPSC: any number of producers, one consumer; reservations are claimed
+ *         with a CAS and become visible to the consumer in reservation
+ *         order, so commit() may briefly wait for an earlier producer
+ *         (and a producer that dies holding a reservation stalls the rest).
+ */
+class ShmRingChannel {
+public:
+    enum class Mode {
+        SPSC,
+        MPSC
+    };
+
+    // Space handed out by reserve(); write up to 'capacity' bytes at 'data'.
+    struct Reservation {
+        char* data = nullptr;
+        size_t capacity = 0;
+        uint64_t start = 0;    // ring position of the record header
+        uint64_t end = 0;      // position just past the record
+    };
+
+    // A record returned by read(); valid until it is released.
+    struct Message {
+        const char* data = nullptr;
+        size_t length = 0;
+        uint64_t next = 0;     // ring position after this record
+    };
+
+    ShmRingChannel();
+    ~ShmRingChannel();
+
+    ShmRingChannel(const ShmRingChannel&) = delete;
+    ShmRingChannel& operator=(const ShmRingChannel&) = delete;
+
+    // Creates (or resets) the named segment with a ring of at least
+    // 'capacity' bytes. Does not unlink it on destruction; use
+    // IPCManager::unlinkSharedMemory once every process has opened it.
+    bool create(const std::string& name, size_t capacity, Mode mode = Mode::SPSC);
+
+    // Maps a channel another process created; mode comes from the segment.
+    bool open(const std::string& name);
+
+    // Unmaps the segment.
+    void close();
+
+    bool isOpen() const { return ctl != nullptr; }
+    Mode mode() const;
+    size_t capacity() const { return mask + 1; }
+
+    // Largest payload a single record can carry
+    size_t maxMessageSize() const;
+
+    // -------------------------------
+    // Producer side
+    // -------------------------------
+
+    // Claims room for a payload of up to 'length' bytes. Returns false if
+    // the ring is too full right now or 'length' exceeds maxMessageSize().
+    bool reserve(size_t length, Reservation& out);
+
+    // Publishes the first 'length' bytes of a reservation; a longer
+    // 'length' is cut to r.capacity.
+    void commit(const Reservation& r, size_t length);
+
+    // Gives a reservation back; the consumer skips it.
+    void cancel(const Reservation& r);
+
+    // reserve() + memcpy + commit()
+    bool send(const void* data, size_t length);
+
+    // -------------------------------
+    // Consumer side (one thread)
+    // -------------------------------
+
+    // Next committed message after the last one read, false if there is
+    // none. The payload stays in the ring until released.
+    bool read(Message& out);
+
+    // Frees 'msg' and every message read before it.
+    void release(const Message& msg);
+
+    // read() + copy + release(); binary-safe.
+    bool receive(std::string& out);
+
+    // Hands every available message (at most 'max') to fn(const char*, size_t)
+    // and frees them with a single index update. Returns the number handled.
+    template <typename F>
+    size_t drain(F&& fn, size_t max = SIZE_MAX);
+
+    // Consumer: nothing committed past what has been read
+    bool empty() const;
+
+    // -------------------------------
+    // Blocking (timeoutMs < 0 waits forever; false on timeout)
+    // -------------------------------
+
+    // Consumer: sleep until empty() is false.
+    bool waitForData(int timeoutMs = -1);
+
+    // Producer: sleep until a 'length'-byte reservation would fit. With
+    // several producers another one may take the space first; retry.
+    bool waitForSpace(size_t length, int timeoutMs = -1);
+
+private:
+    struct Control;
+
+    static const uint32_t PADDING = 0xffffffffu;
+
+    bool map(int fd, size_t size);
+    bool fits(size_t length) const;
+    void publish(uint64_t start, uint64_t end);
+    void writeHeader(uint64_t pos, uint32_t frame, uint32_t payload);
+
+    Control* ctl;
+    char* ring;
+    size_t mask;
+    size_t mappedSize;
+    uint64_t readPos;    // consumer: where read() goes on, past skipped padding
+    uint64_t readEnd;    // consumer: position after the last message read
+};
+
+template <typename F>
+size_t ShmRingChannel::drain(F&& fn, size_t max) {
+    size_t handled = 0;
+    Message msg;
+    while (handled < max && read(msg)) {
+        fn(msg.data, msg.length);
+        ++handled;
+    }
+    if (handled) {
+        release(msg);
+    }
+    return handled;
+}
+
+#endif
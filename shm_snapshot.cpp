@@ -0,0 +1,225 @@
+#include "shm_snapshot.h"
+#include "futex_event.h"
+
+#include <sched.h>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+static const uint32_t SNAPSHOT_MAGIC = 0x534e4150;   // "SNAP"
+
+static inline size_t alignLine(size_t n) {
+    return (n + 63) & ~size_t(63);
+}
+
+// One of the two value buffers. 'seq' is odd while the writer is filling
+// the buffer; 'version' says which publication it holds.
+struct alignas(64) SnapshotSlot {
+    std::atomic<uint64_t> seq;
+    std::atomic<uint64_t> length;
+    std::atomic<uint64_t> version;
+};
+
+struct ShmSnapshot::Control {
+    std::atomic<uint32_t> magic;   // set last by create()
+    uint32_t reserved;
+    uint64_t capacity;
+    alignas(64) std::atomic<uint64_t> version;   // latest published; its slot is version & 1
+    alignas(64) FutexEvent updated;              // waitForUpdate() sleeps here
+    SnapshotSlot slots[2];
+};
+
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+ShmSnapshot::ShmSnapshot() : ctl(nullptr), writer(false), writing(false) {}
+
+ShmSnapshot::~ShmSnapshot() {
+    close();
+}
+
+bool ShmSnapshot::create(const std::string& name, size_t maxSize, const SegmentOptions& options) {
+    close();
+    size_t cap = alignLine(maxSize ? maxSize : 1);
+    if (!segment.create(name, alignLine(sizeof(Control)) + 2 * cap, options)) {
+        return false;
+    }
+
+    ctl = segment.as<Control>();
+    ctl->magic.store(0, std::memory_order_relaxed);
+    ctl->capacity = cap;
+    ctl->version.store(0, std::memory_order_relaxed);
+    ctl->updated.seq.store(0, std::memory_order_relaxed);
+    ctl->updated.waiters.store(0, std::memory_order_relaxed);
+    for (SnapshotSlot& slot : ctl->slots) {
+        slot.seq.store(0, std::memory_order_relaxed);
+        slot.length.store(0, std::memory_order_relaxed);
+        slot.version.store(0, std::memory_order_relaxed);
+    }
+    ctl->magic.store(SNAPSHOT_MAGIC, std::memory_order_release);
+    writer = true;
+    return true;
+}
+
+bool ShmSnapshot::open(const std::string& name, const SegmentOptions& options) {
+    close();
+    if (!segment.open(name, options)) {
+        return false;
+    }
+    Control* c = segment.as<Control>();
+    if (segment.size() < sizeof(Control)
+        || c->magic.load(std::memory_order_acquire) != SNAPSHOT_MAGIC
+        || alignLine(sizeof(Control)) + 2 * c->capacity > segment.size()) {
+        fprintf(stderr, "shared memory '%s' is not a snapshot\n", name.c_str());
+        segment.close();
+        return false;
+    }
+    ctl = c;
+    writer = false;
+    return true;
+}
+
+void ShmSnapshot::close() {
+    segment.close();
+    ctl = nullptr;
+    writer = false;
+    writing = false;
+}
+
+size_t ShmSnapshot::maxSize() const {
+    return ctl ? ctl->capacity : 0;
+}
+
+char* ShmSnapshot::slotData(uint64_t slot) const {
+    return segment.as<char>() + alignLine(sizeof(Control)) + slot * ctl->capacity;
+}
+
+// Writer
+
+char* ShmSnapshot::beginWrite() {
+    if (!ctl || !writer) {
+        return nullptr;
+    }
+    // The slot of the next version, which is not the one readers are sent to.
+    uint64_t slot = (ctl->version.load(std::memory_order_relaxed) + 1) & 1;
+    SnapshotSlot& s = ctl->slots[slot];
+    if (!writing) {
+        s.seq.store(s.seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        // The odd count must be visible before any byte of the new value.
+        std::atomic_thread_fence(std::memory_order_release);
+        writing = true;
+    }
+    return slotData(slot);
+}
+
+void ShmSnapshot::commitWrite(size_t len) {
+    if (!ctl || !writing) {
+        return;
+    }
+    uint64_t next = ctl->version.load(std::memory_order_relaxed) + 1;
+    SnapshotSlot& s = ctl->slots[next & 1];
+    s.length.store(len < ctl->capacity ? len : ctl->capacity, std::memory_order_relaxed);
+    s.version.store(next, std::memory_order_relaxed);
+    s.seq.store(s.seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    writing = false;
+
+    ctl->version.store(next, std::memory_order_release);
+    ctl->updated.notify();
+}
+
+bool ShmSnapshot::publish(const void* data, size_t len) {
+    if (!ctl || !writer || len > ctl->capacity) {
+        return false;
+    }
+    char* buf = beginWrite();
+    memcpy(buf, data, len);
+    commitWrite(len);
+    return true;
+}
+
+// Readers
+
+uint64_t ShmSnapshot::version() const {
+    return ctl ? ctl->version.load(std::memory_order_acquire) : 0;
+}
+
+// Seqlock read: copy(src, len) runs on possibly changing bytes and is
+// simply repeated until the slot's counter shows nothing moved under it.
+template <typename Copy>
+bool ShmSnapshot::readWith(Copy&& copy, uint64_t* versionOut) const {
+    if (!ctl) {
+        return false;
+    }
+    int spins = 0;
+    while (true) {
+        uint64_t v = ctl->version.load(std::memory_order_acquire);
+        if (v == 0) {
+            return false;
+        }
+        const SnapshotSlot& s = ctl->slots[v & 1];
+        uint64_t before = s.seq.load(std::memory_order_acquire);
+        if (!(before & 1)) {
+            size_t len = s.length.load(std::memory_order_relaxed);
+            uint64_t got = s.version.load(std::memory_order_relaxed);
+            bool copied = len <= ctl->capacity && copy(slotData(v & 1), len);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (s.seq.load(std::memory_order_relaxed) == before) {
+                if (copied && versionOut) {
+                    *versionOut = got;
+                }
+                return copied;
+            }
+        }
+        if (++spins < 100) {
+            cpuRelax();
+        } else {
+            sched_yield();
+        }
+    }
+}
+
+bool ShmSnapshot::read(std::string& out, uint64_t* versionOut) const {
+    return readWith([&out](const char* src, size_t len) {
+        out.resize(len);
+        memcpy(&out[0], src, len);
+        return true;
+    }, versionOut);
+}
+
+bool ShmSnapshot::read(void* buf, size_t capacity, size_t& len, uint64_t* versionOut) const {
+    return readWith([buf, capacity, &len](const char* src, size_t n) {
+        len = n;
+        if (n > capacity) {
+            return false;
+        }
+        memcpy(buf, src, n);
+        return true;
+    }, versionOut);
+}
+
+bool ShmSnapshot::waitForUpdate(uint64_t seen, int timeoutMs) const {
+    if (!ctl) {
+        return false;
+    }
+    timespec deadline;
+    if (timeoutMs >= 0) {
+        deadline = futexDeadline(timeoutMs);
+    }
+
+    while (version() <= seen) {
+        uint32_t token = ctl->updated.prepareWait();
+        if (version() > seen) {
+            ctl->updated.cancelWait();
+            break;
+        }
+        if (!ctl->updated.wait(token, timeoutMs >= 0 ? &deadline : nullptr)) {
+            return version() > seen;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,98 @@
+#ifndef SHM_SNAPSHOT_H
+#define SHM_SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "shared_segment.h"
+
+/*
+ * ShmSnapshot:
+ * "Latest value" publication over a named shared segment: one writer
+ * replaces a blob (config, state, routing table, ...) and any number of
+ * reader processes take consistent copies of it, with no locks and no
+ * system calls on either side.
+ *
+ * The segment holds two buffers, each guarded by a sequence counter
+ * (a seqlock). The writer always fills the buffer readers are *not*
+ * being pointed at, then flips the published version, so it never waits
+ * for readers and a reader only has to retry if the writer published
+ * twice while it was copying. Readers detect that from the counter and
+ * copy again; they never see a torn value.
+ *
+ * Readers that want to block until the next version can use
+ * waitForUpdate(), which sleeps on a futex in the segment; publishing
+ * only enters the kernel when somebody is actually asleep.
+ *
+ * The segment belongs to the writer: create() makes it, and it is
+ * unlinked when the writer closes. Readers open() it by name.
+ */
+class ShmSnapshot {
+public:
+    ShmSnapshot();
+    ~ShmSnapshot();
+
+    ShmSnapshot(const ShmSnapshot&) = delete;
+    ShmSnapshot& operator=(const ShmSnapshot&) = delete;
+
+    // Writer: creates the segment for values of up to 'maxSize' bytes.
+    bool create(const std::string& name, size_t maxSize,
+                const SegmentOptions& options = SegmentOptions());
+
+    // Reader: maps a snapshot a writer created ('options' as the writer
+    // used them, for the huge page setting).
+    bool open(const std::string& name, const SegmentOptions& options = SegmentOptions());
+
+    void close();
+
+    bool isOpen() const { return ctl != nullptr; }
+    size_t maxSize() const;
+
+    // -------------------------------
+    // Writer (one thread)
+    // -------------------------------
+
+    // Copies 'len' bytes in and publishes them as the next version.
+    bool publish(const void* data, size_t len);
+    bool publish(const std::string& value) { return publish(value.data(), value.size()); }
+
+    // Zero-copy variant: fill up to maxSize() bytes at the returned
+    // pointer, then commitWrite() the length. The buffer is one readers
+    // are not using, so there is no hurry.
+    char* beginWrite();
+    void commitWrite(size_t len);
+
+    // -------------------------------
+    // Readers (any number, any process)
+    // -------------------------------
+
+    // Number of values published so far; 0 before the first.
+    uint64_t version() const;
+
+    // Consistent copy of the latest value and its version. False if
+    // nothing has been published yet.
+    bool read(std::string& out, uint64_t* versionOut = nullptr) const;
+
+    // Same into a caller buffer; 'len' gets the value's size. False if
+    // nothing has been published or the value does not fit 'capacity'.
+    bool read(void* buf, size_t capacity, size_t& len, uint64_t* versionOut = nullptr) const;
+
+    // Sleeps until version() moves past 'seen'. Returns false on timeout
+    // (timeoutMs < 0 waits forever).
+    bool waitForUpdate(uint64_t seen, int timeoutMs = -1) const;
+
+private:
+    struct Control;
+
+    char* slotData(uint64_t slot) const;
+    template <typename Copy>
+    bool readWith(Copy&& copy, uint64_t* versionOut) const;
+
+    SharedSegment segment;
+    Control* ctl;
+    bool writer;
+    bool writing;     // between beginWrite() and commitWrite()
+};
+
+#endif
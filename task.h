@@ -0,0 +1,168 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+ * Task:
+ * Move-only replacement for std::function<void()>.
+ * Callables up to INLINE_SIZE bytes that are nothrow-movable are stored
+ * inside the Task itself, so typical lambdas never touch the heap.
+ * Anything bigger falls back to a single heap allocation.
+ */
+class Task {
+public:
+    static constexpr size_t INLINE_SIZE = 48;
+
+    Task() noexcept : ops(nullptr) {}
+
+    template <typename F,
+              typename = std::enable_if_t<!std::is_same<std::decay_t<F>, Task>::value>>
+    Task(F&& f) : ops(nullptr) {
+        using Fn = std::decay_t<F>;
+        if constexpr (fitsInline<Fn>()) {
+            new (storage) Fn(std::forward<F>(f));
+            ops = &InlineOps<Fn>::table;
+        } else {
+            *reinterpret_cast<Fn**>(storage) = new Fn(std::forward<F>(f));
+            ops = &HeapOps<Fn>::table;
+        }
+    }
+
+    Task(Task&& other) noexcept : ops(other.ops) {
+        if (ops) {
+            ops->move(storage, other.storage);
+            other.ops = nullptr;
+        }
+    }
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            ops = other.ops;
+            if (ops) {
+                ops->move(storage, other.storage);
+                other.ops = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() { reset(); }
+
+    void operator()() { ops->invoke(storage); }
+
+    explicit operator bool() const noexcept { return ops != nullptr; }
+
+    // True if the callable lives in the inline buffer (no heap allocation).
+    bool isInline() const noexcept { return ops && ops->isInline; }
+
+    void reset() noexcept {
+        if (ops) {
+            ops->destroy(storage);
+            ops = nullptr;
+        }
+    }
+
+private:
+    struct Ops {
+        void (*invoke)(void* self);
+        void (*move)(void* dst, void* src) noexcept;   // move-construct dst, destroy src
+        void (*destroy)(void* self) noexcept;
+        bool isInline;
+    };
+
+    template <typename Fn>
+    static constexpr bool fitsInline() {
+        return sizeof(Fn) <= INLINE_SIZE
+            && alignof(Fn) <= alignof(std::max_align_t)
+            && std::is_nothrow_move_constructible<Fn>::value;
+    }
+
+    template <typename Fn>
+    struct InlineOps {
+        static void invoke(void* self) { (*static_cast<Fn*>(self))(); }
+        static void move(void* dst, void* src) noexcept {
+            new (dst) Fn(std::move(*static_cast<Fn*>(src)));
+            static_cast<Fn*>(src)->~Fn();
+        }
+        static void destroy(void* self) noexcept { static_cast<Fn*>(self)->~Fn(); }
+        static constexpr Ops table = { &invoke, &move, &destroy, true };
+    };
+
+    template <typename Fn>
+    struct HeapOps {
+        static void invoke(void* self) { (**static_cast<Fn**>(self))(); }
+        static void move(void* dst, void* src) noexcept {
+            *static_cast<Fn**>(dst) = *static_cast<Fn**>(src);
+        }
+        static void destroy(void* self) noexcept { delete *static_cast<Fn**>(self); }
+        static constexpr Ops table = { &invoke, &move, &destroy, false };
+    };
+
+    alignas(std::max_align_t) unsigned char storage[INLINE_SIZE];
+    const Ops* ops;
+};
+
+/*
+ * FifoRing:
+ * FIFO backed by a growable ring buffer. Unlike std::queue (std::deque
+ * underneath) it stops allocating once it has reached its high-water
+ * mark. Not thread-safe.
+ */
+template <typename T>
+class FifoRing {
+public:
+    explicit FifoRing(size_t capacity = 64) : slots(roundUp(capacity)), head(0), count(0) {}
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+
+    void push(T&& item) {
+        if (count == slots.size()) {
+            grow();
+        }
+        slots[(head + count) & (slots.size() - 1)] = std::move(item);
+        ++count;
+    }
+
+    T& front() { return slots[head]; }
+    const T& front() const { return slots[head]; }
+
+    void pop() {
+        slots[head] = T();
+        head = (head + 1) & (slots.size() - 1);
+        --count;
+    }
+
+private:
+    static size_t roundUp(size_t n) {
+        size_t cap = 1;
+        while (cap < n) {
+            cap <<= 1;
+        }
+        return cap;
+    }
+
+    void grow() {
+        std::vector<T> bigger(slots.size() * 2);
+        for (size_t i = 0; i < count; ++i) {
+            bigger[i] = std::move(slots[(head + i) & (slots.size() - 1)]);
+        }
+        slots.swap(bigger);
+        head = 0;
+    }
+
+    std::vector<T> slots;
+    size_t head;
+    size_t count;
+};
+
+#endif
@@ -1,71 +1,787 @@
 #include "thread_pool.h"
+#include <sched.h>
+#include <cerrno>
+#include <ctime>
 #include <iostream>
 
-ThreadPool::ThreadPool(size_t numThreads) : stopping(false) {
-    pthread_mutex_init(&queueMutex, nullptr);
-    pthread_cond_init(&queueCond, nullptr);
+thread_local ThreadPool::Worker* ThreadPool::currentWorker = nullptr;
+thread_local ThreadPool::NodeCache ThreadPool::nodeCache;
 
-    workers.resize(numThreads);
-    for (size_t i = 0; i < numThreads; ++i) {
-        int rc = pthread_create(&workers[i], nullptr, &ThreadPool::workerEntry, this);
-        if (rc != 0) {
-            std::cerr << "Failed to create worker thread, error: " << rc << std::endl;
+// Deque nodes are recycled per thread so local pushes don't hit malloc.
+// A stolen node ends up in the thief's cache; the cap keeps a thread that
+// only consumes from hoarding memory.
+static const size_t NODE_CACHE_LIMIT = 1024;
+
+// Lock-free workers look at the global queue before their own sources
+// every this many tasks, so aged work there is not starved by local work.
+static const unsigned GLOBAL_POLL_INTERVAL = 61;
+
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+ThreadPool::NodeCache::~NodeCache() {
+    while (head) {
+        TaskNode* next = head->next;
+        delete head;
+        head = next;
+    }
+}
+
+ThreadPool::ThreadPool(size_t numThreads, SchedulingMode mode)
+    : ThreadPool([&] {
+          ThreadPoolConfig cfg;
+          cfg.numThreads = numThreads;
+          cfg.mode = mode;
+          return cfg;
+      }()) {}
+
+ThreadPool::NodeQueue::NodeQueue(const ThreadPoolConfig& config)
+    : queue(config.agingInterval, config.deadlineSlack), size(0), urgent(0), sleepers(0) {
+    pthread_mutex_init(&mutex, nullptr);
+
+    // Idle timeouts must not jump with the wall clock.
+    pthread_condattr_t condAttr;
+    pthread_condattr_init(&condAttr);
+    pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC);
+    pthread_cond_init(&cond, &condAttr);
+    pthread_condattr_destroy(&condAttr);
+
+    if (config.mode == SchedulingMode::LOCK_FREE_RING) {
+        ring.reset(new MpmcRingQueue<QueuedTask>(config.ringCapacity));
+    }
+}
+
+ThreadPool::NodeQueue::~NodeQueue() {
+    pthread_mutex_destroy(&mutex);
+    pthread_cond_destroy(&cond);
+}
+
+ThreadPool::ThreadPool(const ThreadPoolConfig& config)
+    : config(config), stopping(false), liveWorkers(0), slotsInUse(0), spawnInFlight(false),
+      startTime(Clock::now()) {
+    pthread_mutex_init(&workersMutex, nullptr);
+    pthread_mutex_init(&spawnMutex, nullptr);
+
+    size_t initial = this->config.numThreads;
+    size_t slots = initial;
+    if (this->config.elastic) {
+        ThreadPoolConfig& cfg = this->config;
+        cfg.minThreads = cfg.minThreads < 1 ? 1 : cfg.minThreads;
+        cfg.maxThreads = cfg.maxThreads < cfg.minThreads ? cfg.minThreads : cfg.maxThreads;
+        initial = initial < cfg.minThreads ? cfg.minThreads : initial;
+        initial = initial > cfg.maxThreads ? cfg.maxThreads : initial;
+        slots = cfg.maxThreads;
+    }
+
+    size_t numNodes = 1;
+    if (config.numaAware) {
+        topology = CpuTopology::detect();
+        numNodes = topology.numNodes();
+    }
+    for (size_t n = 0; n < numNodes; ++n) {
+        nodes.emplace_back(new NodeQueue(this->config));
+    }
+
+    // Allocate every worker slot before starting any thread, thieves walk the whole list.
+    for (size_t i = 0; i < slots; ++i) {
+        std::unique_ptr<Worker> w(new Worker());
+        w->pool = this;
+        w->index = i;
+        w->node = 0;
+        w->rng = static_cast<unsigned>(i) * 2654435761u + 1;
+        w->tick = 0;
+        w->running = false;
+        if (config.collectMetrics) {
+            w->metrics.reset(new WorkerMetrics());
         }
+
+        if (!config.cpuSet.empty()) {
+            int cpu = config.cpuSet[i % config.cpuSet.size()];
+            w->cpus.push_back(cpu);
+            int node = config.numaAware ? topology.nodeIndexOfCpu(cpu) : -1;
+            w->node = node < 0 ? 0 : static_cast<size_t>(node);
+        } else if (config.numaAware) {
+            w->node = i % numNodes;
+            w->cpus = topology.cpusOfNode(w->node);
+        }
+        workers.push_back(std::move(w));
+    }
+
+    for (size_t i = 0; i < initial; ++i) {
+        Worker& w = *workers[i];
+        w.running = true;
+        slotsInUse.store(i + 1, std::memory_order_relaxed);
+        if (startThread(w) != 0) {
+            w.running = false;
+            continue;
+        }
+        liveWorkers.fetch_add(1, std::memory_order_relaxed);
     }
 }
 
 ThreadPool::~ThreadPool() {
     shutdown();
-    pthread_mutex_destroy(&queueMutex);
-    pthread_cond_destroy(&queueCond);
+    pthread_mutex_destroy(&workersMutex);
+    pthread_mutex_destroy(&spawnMutex);
 }
 
-void ThreadPool::submit(const std::function<void()>& task) {
-    pthread_mutex_lock(&queueMutex);
-    taskQueue.push(task);
-    pthread_cond_signal(&queueCond);
-    pthread_mutex_unlock(&queueMutex);
+void ThreadPool::post(Task task) {
+    post(TaskOptions(), std::move(task));
+}
+
+void ThreadPool::post(const TaskOptions& options, Task task) {
+    if (options.priority != TaskPriority::NORMAL || options.hasDeadline()) {
+        pushGlobal(std::move(task), options);
+        return;
+    }
+
+    Worker* self = localWorker();
+    if (self && options.numaNode < 0) {
+        // Local push: no lock, only wake someone if a worker is parked.
+        TaskNode* node = acquireNode();
+        node->task = std::move(task);
+        node->enqueued = stamp();
+        self->deque.push(node);
+        wakeWorkers(self->node, 1);
+        maybeGrow(self->deque.size());
+        return;
+    }
+
+    size_t home = homeNode(options);
+    if (MpmcRingQueue<QueuedTask>* ring = nodes[home]->ring.get()) {
+        QueuedTask queued{std::move(task), stamp()};
+        if (ring->tryPush(std::move(queued))) {
+            wakeWorkers(home, 1);
+            maybeGrow(ring->size());
+            return;
+        }
+        task = std::move(queued.task);
+    }
+
+    // SHARED_QUEUE, external WORK_STEALING submitters, or a full ring
+    pushGlobal(std::move(task), options);
+}
+
+void ThreadPool::pushGlobal(Task&& task, const TaskOptions& options) {
+    size_t home = homeNode(options);
+    NodeQueue& node = *nodes[home];
+
+    auto now = PriorityTaskQueue::Clock::now();
+    pthread_mutex_lock(&node.mutex);
+    node.queue.push(std::move(task), options, now);
+    size_t queued = node.queue.size();
+    node.size.store(queued, std::memory_order_relaxed);
+    node.urgent.store(node.queue.urgentSize(), std::memory_order_relaxed);
+    bool wokeLocal = node.sleepers.load(std::memory_order_relaxed) > 0;
+    wakeLocked(node, 1);
+    pthread_mutex_unlock(&node.mutex);
+
+    // Nobody idle on the home node: let a worker of another node take it.
+    if (!wokeLocal && nodes.size() > 1) {
+        wakeWorkers(home, 1);
+    }
+    maybeGrow(queued);
+}
+
+ThreadPool::Worker* ThreadPool::localWorker() const {
+    Worker* self = currentWorker;
+    if (config.mode == SchedulingMode::WORK_STEALING && self && self->pool == this) {
+        return self;
+    }
+    return nullptr;
+}
+
+// Node whose queues take a task: the requested one, else the submitting
+// worker's, else the node of the CPU we are running on.
+size_t ThreadPool::homeNode(const TaskOptions& options) const {
+    if (nodes.size() == 1) {
+        return 0;
+    }
+    if (options.numaNode >= 0) {
+        int index = topology.nodeIndexOfId(options.numaNode);
+        if (index >= 0) {
+            return static_cast<size_t>(index);
+        }
+    }
+    Worker* self = currentWorker;
+    if (self && self->pool == this) {
+        return self->node;
+    }
+    int index = topology.nodeIndexOfCpu(sched_getcpu());
+    return index < 0 ? 0 : static_cast<size_t>(index);
+}
+
+// Caller holds node.mutex.
+void ThreadPool::wakeLocked(NodeQueue& node, size_t count) {
+    size_t idle = node.sleepers.load(std::memory_order_relaxed);
+    if (count == 0 || idle == 0) {
+        return;
+    }
+    if (count >= idle) {
+        pthread_cond_broadcast(&node.cond);
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        pthread_cond_signal(&node.cond);
+    }
+}
+
+// Wake up to 'count' parked workers, home node first. Pairs with the fence
+// in park(): either the parking worker sees the pushed tasks or we see it
+// in 'sleepers'.
+void ThreadPool::wakeWorkers(size_t home, size_t count) {
+    if (count == 0) {
+        return;
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (size_t i = 0; i < nodes.size() && count > 0; ++i) {
+        NodeQueue& node = *nodes[(home + i) % nodes.size()];
+        size_t idle = node.sleepers.load(std::memory_order_relaxed);
+        if (idle == 0) {
+            continue;
+        }
+        pthread_mutex_lock(&node.mutex);
+        wakeLocked(node, count);
+        pthread_mutex_unlock(&node.mutex);
+        count = idle >= count ? 0 : count - idle;
+    }
 }
 
 void ThreadPool::shutdown() {
-    pthread_mutex_lock(&queueMutex);
-    if (stopping) {
-        pthread_mutex_unlock(&queueMutex);
+    // spawnMutex first so no worker is half-created while we collect threads
+    pthread_mutex_lock(&spawnMutex);
+    if (stopping.exchange(true)) {
+        pthread_mutex_unlock(&spawnMutex);
+        return;
+    }
+    for (auto &node : nodes) {
+        pthread_mutex_lock(&node->mutex);
+        pthread_cond_broadcast(&node->cond);
+        pthread_mutex_unlock(&node->mutex);
+    }
+
+    std::vector<pthread_t> toJoin;
+    pthread_mutex_lock(&workersMutex);
+    toJoin.swap(retiredThreads);
+    for (auto &w : workers) {
+        if (w->running) {
+            toJoin.push_back(w->thread);
+        }
+    }
+    pthread_mutex_unlock(&workersMutex);
+    pthread_mutex_unlock(&spawnMutex);
+
+    for (pthread_t t : toJoin) {
+        pthread_join(t, nullptr);
+    }
+}
+
+// Create the worker's thread, pinned to w.cpus if set. Pinning to CPUs we
+// may not use fails with EINVAL; the worker then runs unpinned.
+int ThreadPool::startThread(Worker& w) {
+    int rc;
+    if (!w.cpus.empty()) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int cpu : w.cpus) {
+            if (cpu >= 0 && cpu < CPU_SETSIZE) {
+                CPU_SET(cpu, &cpus);
+            }
+        }
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+        rc = pthread_create(&w.thread, &attr, &ThreadPool::workerEntry, &w);
+        pthread_attr_destroy(&attr);
+        if (rc != EINVAL) {
+            if (rc != 0) {
+                std::cerr << "Failed to create worker thread, error: " << rc << std::endl;
+            }
+            return rc;
+        }
+        std::cerr << "Failed to pin worker " << w.index << ", running it unpinned" << std::endl;
+    }
+    rc = pthread_create(&w.thread, nullptr, &ThreadPool::workerEntry, &w);
+    if (rc != 0) {
+        std::cerr << "Failed to create worker thread, error: " << rc << std::endl;
+    }
+    return rc;
+}
+
+// Elastic resizing
+
+// Caller holds node.mutex. Returns false if the wait hit idleTimeout.
+bool ThreadPool::waitForWork(NodeQueue& node) {
+    if (!config.elastic) {
+        pthread_cond_wait(&node.cond, &node.mutex);
+        return true;
+    }
+
+    timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    auto timeout = std::chrono::duration_cast<std::chrono::nanoseconds>(config.idleTimeout).count();
+    deadline.tv_sec += timeout / 1000000000;
+    deadline.tv_nsec += timeout % 1000000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000;
+    }
+    return pthread_cond_timedwait(&node.cond, &node.mutex, &deadline) != ETIMEDOUT;
+}
+
+// Caller holds its node's mutex and has just re-checked that there is no
+// work. minThreads >= 1 guarantees another worker is left to pick up
+// anything submitted while this one leaves.
+bool ThreadPool::tryRetire(Worker& self) {
+    if (!config.elastic) {
+        return false;
+    }
+    pthread_mutex_lock(&workersMutex);
+    bool retire = !stopping.load(std::memory_order_relaxed)
+                  && liveWorkers.load(std::memory_order_relaxed) > config.minThreads;
+    if (retire) {
+        self.running = false;
+        liveWorkers.fetch_sub(1, std::memory_order_relaxed);
+        retiredThreads.push_back(pthread_self());
+    }
+    pthread_mutex_unlock(&workersMutex);
+    return retire;
+}
+
+size_t ThreadPool::idleWorkers() const {
+    size_t idle = 0;
+    for (auto &node : nodes) {
+        idle += node->sleepers.load(std::memory_order_relaxed);
+    }
+    return idle;
+}
+
+void ThreadPool::maybeGrow(size_t queued) {
+    if (!config.elastic || queued < config.spawnQueueDepth || idleWorkers() > 0) {
+        return;
+    }
+    spawnWorker();
+}
+
+void ThreadPool::maybeGrowAfterWait(PriorityTaskQueue::Clock::time_point enqueued,
+                                    PriorityTaskQueue::Clock::time_point now) {
+    if (!config.elastic || now - enqueued < config.spawnWaitTime || idleWorkers() > 0) {
         return;
     }
-    stopping = true;
-    pthread_cond_broadcast(&queueCond);
-    pthread_mutex_unlock(&queueMutex);
+    spawnWorker();
+}
+
+// Start one more worker unless at maxThreads. Only one spawn is in flight
+// at a time: the flag is cleared by the new worker once it runs, so a burst
+// grows the pool step by step instead of all at once.
+bool ThreadPool::spawnWorker() {
+    if (spawnInFlight.exchange(true, std::memory_order_acquire)) {
+        return false;
+    }
+
+    pthread_mutex_lock(&spawnMutex);
+    pthread_mutex_lock(&workersMutex);
+    Worker* slot = nullptr;
+    if (!stopping.load(std::memory_order_relaxed)
+        && liveWorkers.load(std::memory_order_relaxed) < config.maxThreads) {
+        for (auto &w : workers) {
+            if (!w->running) {
+                slot = w.get();
+                break;
+            }
+        }
+    }
+    if (slot) {
+        slot->running = true;
+        liveWorkers.fetch_add(1, std::memory_order_relaxed);
+        if (slotsInUse.load(std::memory_order_relaxed) <= slot->index) {
+            slotsInUse.store(slot->index + 1, std::memory_order_relaxed);
+        }
+    }
+    std::vector<pthread_t> toJoin;
+    toJoin.swap(retiredThreads);
+    pthread_mutex_unlock(&workersMutex);
 
-    for (auto &t : workers) {
+    // Retired workers have already left their loop; this only reaps them.
+    for (pthread_t t : toJoin) {
         pthread_join(t, nullptr);
     }
+
+    bool started = false;
+    if (slot) {
+        if (startThread(*slot) != 0) {
+            pthread_mutex_lock(&workersMutex);
+            slot->running = false;
+            liveWorkers.fetch_sub(1, std::memory_order_relaxed);
+            pthread_mutex_unlock(&workersMutex);
+        } else {
+            started = true;
+        }
+    }
+    pthread_mutex_unlock(&spawnMutex);
+
+    if (!started) {
+        spawnInFlight.store(false, std::memory_order_release);
+    }
+    return started;
 }
 
 void* ThreadPool::workerEntry(void* arg) {
-    ThreadPool* pool = static_cast<ThreadPool*>(arg);
-    pool->workerLoop();
+    Worker* self = static_cast<Worker*>(arg);
+    ThreadPool* pool = self->pool;
+    currentWorker = self;
+    self->lastActive = Clock::now();
+    pool->spawnInFlight.store(false, std::memory_order_release);
+    if (pool->config.mode == SchedulingMode::SHARED_QUEUE && pool->nodes.size() == 1) {
+        pool->workerLoop(*self);
+    } else {
+        pool->multiQueueWorkerLoop(*self);
+    }
+    currentWorker = nullptr;
     return nullptr;
 }
 
-void ThreadPool::workerLoop() {
+// SHARED_QUEUE on a single node: everything goes through one mutex.
+void ThreadPool::workerLoop(Worker& self) {
+    NodeQueue& node = *nodes[0];
+
     while (true) {
-        pthread_mutex_lock(&queueMutex);
+        pthread_mutex_lock(&node.mutex);
 
-        while (taskQueue.empty() && !stopping) {
-            pthread_cond_wait(&queueCond, &queueMutex);
+        bool timedOut = false;
+        bool retired = false;
+        while (node.queue.empty() && !stopping.load(std::memory_order_relaxed)) {
+            if (timedOut && tryRetire(self)) {
+                retired = true;
+                break;
+            }
+            node.sleepers.fetch_add(1, std::memory_order_relaxed);
+            timedOut = !waitForWork(node);
+            node.sleepers.fetch_sub(1, std::memory_order_relaxed);
         }
 
-        if (stopping && taskQueue.empty()) {
-            pthread_mutex_unlock(&queueMutex);
+        if (retired || node.queue.empty()) {
+            pthread_mutex_unlock(&node.mutex);
             break;
         }
 
-        auto task = taskQueue.front();
-        taskQueue.pop();
-        pthread_mutex_unlock(&queueMutex);
+        Task task;
+        auto now = PriorityTaskQueue::Clock::now();
+        PriorityTaskQueue::Clock::time_point enqueued;
+        node.queue.pop(task, now, &enqueued);
+        node.size.store(node.queue.size(), std::memory_order_relaxed);
+        node.urgent.store(node.queue.urgentSize(), std::memory_order_relaxed);
+        pthread_mutex_unlock(&node.mutex);
+
+        maybeGrowAfterWait(enqueued, now);
 
         // Execute task outside lock
+        runTask(self, task, enqueued);
+    }
+}
+
+// WORK_STEALING, LOCK_FREE_RING, and SHARED_QUEUE with several nodes
+
+void ThreadPool::multiQueueWorkerLoop(Worker& self) {
+    Task task;
+    Clock::time_point enqueued;
+
+    while (true) {
+        if (findTask(self, task, enqueued)) {
+            runTask(self, task, enqueued);
+            task.reset();
+            continue;
+        }
+        if (spinForWork(self)) {
+            continue;
+        }
+        if (!park(self)) {
+            break;
+        }
+    }
+}
+
+bool ThreadPool::findTask(Worker& self, Task& out, Clock::time_point& enqueued) {
+    // HIGH and deadline tasks only ever sit in the global queues; take them
+    // before anything local.
+    bool pollGlobal = ++self.tick % GLOBAL_POLL_INTERVAL == 0;
+    if (!pollGlobal) {
+        for (auto &node : nodes) {
+            if (node->urgent.load(std::memory_order_relaxed) > 0) {
+                pollGlobal = true;
+                break;
+            }
+        }
+    }
+    if (pollGlobal && popGlobal(self, out, enqueued)) {
+        return true;
+    }
+
+    if (config.mode == SchedulingMode::LOCK_FREE_RING) {
+        return popRing(self, out, enqueued) || popGlobal(self, out, enqueued);
+    }
+    if (config.mode == SchedulingMode::SHARED_QUEUE) {
+        return popGlobal(self, out, enqueued);
+    }
+
+    // Own deque first (LIFO, cache-hot), then external submissions, then peers.
+    // Depth is re-checked on the consumer side too, so a backlog that built
+    // up while a spawn was in flight still grows the pool.
+    TaskNode* node = self.deque.pop();
+    if (node) {
+        maybeGrow(self.deque.size());
+    } else {
+        if (popGlobal(self, out, enqueued)) {
+            return true;
+        }
+        node = stealFromPeers(self);
+    }
+    if (node) {
+        out = std::move(node->task);
+        enqueued = node->enqueued;
+        releaseNode(node);
+        return true;
+    }
+    return false;
+}
+
+bool ThreadPool::hasVisibleWork(const Worker& self) const {
+    for (auto &node : nodes) {
+        if (node->size.load(std::memory_order_relaxed) > 0
+            || (node->ring && !node->ring->empty())) {
+            return true;
+        }
+    }
+    return config.mode == SchedulingMode::WORK_STEALING && peersHaveWork(self);
+}
+
+// Poll for a while before paying for a futex sleep and wakeup.
+bool ThreadPool::spinForWork(const Worker& self) const {
+    for (size_t i = 0; i < config.spinCount; ++i) {
+        cpuRelax();
+        if (hasVisibleWork(self)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Sleep on the worker's own node until there is work anywhere. Returns
+// false once the pool is stopping and every queue is drained, or when this
+// worker retires after idleTimeout.
+bool ThreadPool::park(Worker& self) {
+    NodeQueue& node = *nodes[self.node];
+
+    // Registering as a sleeper before re-checking the lock-free queues pairs
+    // with the fence in wakeWorkers().
+    pthread_mutex_lock(&node.mutex);
+    node.sleepers.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    bool keepRunning = true;
+    bool timedOut = false;
+    while (node.queue.empty() && !hasVisibleWork(self)) {
+        if (stopping.load(std::memory_order_relaxed) || (timedOut && tryRetire(self))) {
+            keepRunning = false;
+            break;
+        }
+        timedOut = !waitForWork(node);
+    }
+
+    node.sleepers.fetch_sub(1, std::memory_order_relaxed);
+    pthread_mutex_unlock(&node.mutex);
+    return keepRunning;
+}
+
+// Metrics
+
+static inline void addRelaxed(std::atomic<uint64_t>& counter, uint64_t n) {
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+static inline uint64_t nanosSince(std::chrono::steady_clock::time_point from,
+                                  std::chrono::steady_clock::time_point to) {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count();
+    return ns > 0 ? static_cast<uint64_t>(ns) : 0;
+}
+
+void ThreadPool::runTask(Worker& self, Task& task, Clock::time_point enqueued) {
+    WorkerMetrics* m = self.metrics.get();
+    if (!m) {
         task();
+        return;
+    }
+
+    auto start = Clock::now();
+    addRelaxed(m->idleNs, nanosSince(self.lastActive, start));
+    if (enqueued != Clock::time_point()) {
+        m->queueWait.record(nanosSince(enqueued, start));
+    }
+
+    task();
+
+    auto end = Clock::now();
+    uint64_t ran = nanosSince(start, end);
+    m->runTime.record(ran);
+    addRelaxed(m->busyNs, ran);
+    addRelaxed(m->tasks, 1);
+    self.lastActive = end;
+}
+
+ThreadPoolStats ThreadPool::stats() const {
+    ThreadPoolStats out;
+    out.tasksExecuted = 0;
+    out.steals = 0;
+    out.busyTime = std::chrono::nanoseconds(0);
+    out.idleTime = std::chrono::nanoseconds(0);
+    out.queuedTasks = 0;
+
+    for (auto &node : nodes) {
+        out.queuedTasks += node->size.load(std::memory_order_relaxed);
+        if (node->ring) {
+            out.queuedTasks += node->ring->size();
+        }
+    }
+
+    size_t n = slotsInUse.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < n; ++i) {
+        const Worker& w = *workers[i];
+        out.queuedTasks += w.deque.size();
+
+        WorkerStats ws = WorkerStats();
+        pthread_mutex_lock(&workersMutex);
+        ws.running = w.running;
+        pthread_mutex_unlock(&workersMutex);
+
+        if (const WorkerMetrics* m = w.metrics.get()) {
+            ws.tasksExecuted = m->tasks.load(std::memory_order_relaxed);
+            ws.steals = m->steals.load(std::memory_order_relaxed);
+            ws.busyTime = std::chrono::nanoseconds(m->busyNs.load(std::memory_order_relaxed));
+            ws.idleTime = std::chrono::nanoseconds(m->idleNs.load(std::memory_order_relaxed));
+            out.queueWait.merge(m->queueWait);
+            out.runTime.merge(m->runTime);
+        }
+        out.tasksExecuted += ws.tasksExecuted;
+        out.steals += ws.steals;
+        out.busyTime += ws.busyTime;
+        out.idleTime += ws.idleTime;
+        out.workers.push_back(ws);
+    }
+
+    out.uptime = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - startTime);
+    double seconds = std::chrono::duration<double>(out.uptime).count();
+    out.tasksPerSecond = seconds > 0 ? out.tasksExecuted / seconds : 0.0;
+    return out;
+}
+
+ThreadPool::TaskNode* ThreadPool::acquireNode() {
+    TaskNode* node = nodeCache.head;
+    if (node) {
+        nodeCache.head = node->next;
+        --nodeCache.count;
+        return node;
+    }
+    return new TaskNode();
+}
+
+void ThreadPool::releaseNode(TaskNode* node) {
+    node->task.reset();
+    if (nodeCache.count >= NODE_CACHE_LIMIT) {
+        delete node;
+        return;
+    }
+    node->next = nodeCache.head;
+    nodeCache.head = node;
+    ++nodeCache.count;
+}
+
+// Own node's queue first, then the other nodes'.
+bool ThreadPool::popGlobal(Worker& self, Task& out, Clock::time_point& enqueued) {
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (popNode(*nodes[(self.node + i) % nodes.size()], out, enqueued)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::popNode(NodeQueue& node, Task& out, Clock::time_point& enqueued) {
+    if (node.size.load(std::memory_order_relaxed) == 0) {
+        return false;
+    }
+
+    pthread_mutex_lock(&node.mutex);
+    if (node.queue.empty()) {
+        pthread_mutex_unlock(&node.mutex);
+        return false;
+    }
+    auto now = Clock::now();
+    node.queue.pop(out, now, &enqueued);
+    node.size.store(node.queue.size(), std::memory_order_relaxed);
+    node.urgent.store(node.queue.urgentSize(), std::memory_order_relaxed);
+    pthread_mutex_unlock(&node.mutex);
+
+    maybeGrowAfterWait(enqueued, now);
+    return true;
+}
+
+bool ThreadPool::popRing(Worker& self, Task& out, Clock::time_point& enqueued) {
+    QueuedTask queued;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        MpmcRingQueue<QueuedTask>& ring = *nodes[(self.node + i) % nodes.size()]->ring;
+        if (ring.tryPop(queued)) {
+            out = std::move(queued.task);
+            enqueued = queued.enqueued;
+            maybeGrow(ring.size());
+            return true;
+        }
+    }
+    return false;
+}
+
+// Same-node victims first: their tasks' data is more likely in a cache we share.
+ThreadPool::TaskNode* ThreadPool::stealFromPeers(Worker& self) {
+    size_t n = slotsInUse.load(std::memory_order_relaxed);
+    if (n < 2) {
+        return nullptr;
+    }
+
+    // xorshift to pick a random starting victim
+    self.rng ^= self.rng << 13;
+    self.rng ^= self.rng >> 17;
+    self.rng ^= self.rng << 5;
+    size_t start = self.rng % n;
+
+    size_t passes = nodes.size() > 1 ? 2 : 1;
+    for (size_t pass = 0; pass < passes; ++pass) {
+        for (size_t i = 0; i < n; ++i) {
+            Worker& victim = *workers[(start + i) % n];
+            if (&victim == &self || (passes > 1 && (victim.node == self.node) != (pass == 0))) {
+                continue;
+            }
+            if (TaskNode* task = victim.deque.steal()) {
+                if (WorkerMetrics* m = self.metrics.get()) {
+                    addRelaxed(m->steals, 1);
+                }
+                return task;
+            }
+        }
+    }
+    return nullptr;
+}
+
+bool ThreadPool::peersHaveWork(const Worker& self) const {
+    size_t n = slotsInUse.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < n; ++i) {
+        const Worker& w = *workers[i];
+        if (&w != &self && !w.deque.empty()) {
+            return true;
+        }
     }
+    return false;
 }
\ No newline at end of file
@@ -2,32 +2,481 @@
 #define THREAD_POOL_H
 
 #include <pthread.h>
-#include <queue>
-#include <functional>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <future>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "cpu_topology.h"
+#include "latency_histogram.h"
+#include "mpmc_queue.h"
+#include "priority_task_queue.h"
+#include "task.h"
+#include "work_stealing_deque.h"
+
+enum class SchedulingMode {
+    SHARED_QUEUE,    // one mutex-protected FIFO shared by every worker
+    WORK_STEALING,   // per-worker deques; global queue only for external submitters
+    LOCK_FREE_RING   // bounded lock-free MPMC ring; global queue only on overflow
+};
+
+struct ThreadPoolConfig {
+    size_t numThreads = 4;
+    SchedulingMode mode = SchedulingMode::SHARED_QUEUE;
+
+    // LOCK_FREE_RING: ring slots (rounded up to a power of two)
+    size_t ringCapacity = 4096;
+
+    // WORK_STEALING / LOCK_FREE_RING: polls of the queues an idle worker
+    // makes before parking on the condition variable
+    size_t spinCount = 256;
+
+    // Every agingInterval a queued task waits promotes it by one priority
+    // class (zero disables aging)
+    std::chrono::milliseconds agingInterval{50};
+
+    // A task whose deadline is this close runs ahead of every class
+    std::chrono::milliseconds deadlineSlack{5};
+
+    // Elastic mode: start with numThreads, add workers (up to maxThreads)
+    // while work backs up and no worker is idle, and retire workers that
+    // have been idle for idleTimeout (down to minThreads, at least 1).
+    bool elastic = false;
+    size_t minThreads = 1;
+    size_t maxThreads = 64;
+    size_t spawnQueueDepth = 32;                    // queued tasks
+    std::chrono::milliseconds spawnWaitTime{5};     // queue wait of a task just dequeued
+    std::chrono::milliseconds idleTimeout{10000};
+
+    // CPUs to pin workers to, one CPU per worker, round-robin. Empty means
+    // no pinning (or, with numaAware, pinning to the worker's node).
+    std::vector<int> cpuSet;
+
+    // Spread workers over the NUMA nodes, give every node its own queues
+    // and honour TaskOptions::numaNode. Workers look at their own node's
+    // queues first and only then at remote ones.
+    bool numaAware = false;
+
+    // Per-worker counters and latency histograms, read through stats().
+    // Costs two clock reads per task plus one per submission when enabled.
+    bool collectMetrics = false;
+};
+
+struct WorkerStats {
+    bool running;
+    uint64_t tasksExecuted;
+    uint64_t steals;                     // WORK_STEALING only
+    std::chrono::nanoseconds busyTime;   // running tasks
+    std::chrono::nanoseconds idleTime;   // between tasks, booked when the next one starts
+};
+
+struct ThreadPoolStats {
+    std::vector<WorkerStats> workers;    // every worker slot used so far
+    uint64_t tasksExecuted;
+    uint64_t steals;
+    std::chrono::nanoseconds busyTime;
+    std::chrono::nanoseconds idleTime;
+    std::chrono::nanoseconds uptime;
+    double tasksPerSecond;               // tasksExecuted / uptime
+    size_t queuedTasks;                  // approximate
+    LatencyHistogram queueWait;          // ns from submission to start of execution
+    LatencyHistogram runTime;            // ns spent in the task
+};
+
 class ThreadPool {
 public:
-    explicit ThreadPool(size_t numThreads);
+    explicit ThreadPool(size_t numThreads, SchedulingMode mode = SchedulingMode::SHARED_QUEUE);
+    explicit ThreadPool(const ThreadPoolConfig& config);
     ~ThreadPool();
 
-    // Submit a task 
-    void submit(const std::function<void()>& task);
+    // Submit a callable with its arguments; the returned future yields the
+    // result (or rethrows the exception) once the task has run.
+    template <typename F, typename... Args>
+    auto submit(F&& f, Args&&... args)
+        -> std::future<std::invoke_result_t<std::decay_t<F>&, std::decay_t<Args>...>>;
+
+    // As above, with a priority class, deadline and/or NUMA node. Tasks with
+    // a non-default priority or a deadline always go through the global
+    // priority queue of their node.
+    template <typename F, typename... Args>
+    auto submit(const TaskOptions& options, F&& f, Args&&... args)
+        -> std::future<std::invoke_result_t<std::decay_t<F>&, std::decay_t<Args>...>>;
+
+    // Fire-and-forget submission, no future. In WORK_STEALING mode a task
+    // posted from one of this pool's workers goes to that worker's local deque.
+    void post(Task task);
+    void post(const TaskOptions& options, Task task);
+
+    // Enqueue every callable in 'tasks' with a single lock acquisition and
+    // wake at most as many parked workers as there are new tasks. Elements
+    // are moved out of an rvalue range and copied from an lvalue one.
+    template <typename Range>
+    void submitBatch(Range&& tasks);
+
+    // Run fn(i) for every i in [begin, end). The range is claimed in chunks
+    // of at least 'grain' indices that shrink as the remaining work does, and
+    // the calling thread takes part, so it is safe to call from a pool task.
+    // Rethrows the first exception thrown by fn.
+    template <typename F>
+    void parallelFor(size_t begin, size_t end, size_t grain, F&& fn);
+
+    // Live workers; changes over time in elastic mode
+    size_t size() const { return liveWorkers.load(std::memory_order_relaxed); }
+
+    // Queue groups: the number of NUMA nodes with numaAware, otherwise 1
+    size_t numNodes() const { return nodes.size(); }
 
     //finish pending tasks then exit
     void shutdown();
 
+    // shutdown() has been called; tasks posted from now on may never run
+    bool isStopping() const { return stopping.load(std::memory_order_relaxed); }
+
+    SchedulingMode getMode() const { return config.mode; }
+
+    // Aggregated snapshot of the per-worker metrics; counters and histograms
+    // stay empty unless config.collectMetrics is set. Safe to call at any time.
+    ThreadPoolStats stats() const;
+
 private:
+    using Clock = PriorityTaskQueue::Clock;
+
+    // Deque element; recycled through a per-thread free list
+    struct TaskNode {
+        Task task;
+        Clock::time_point enqueued;   // only with collectMetrics
+        TaskNode* next;
+    };
+
+    // Ring element; the timestamp fits in the cell's padding
+    struct QueuedTask {
+        Task task;
+        Clock::time_point enqueued;   // only with collectMetrics
+    };
+
+    // Written by the owning worker only, read by stats()
+    struct alignas(64) WorkerMetrics {
+        std::atomic<uint64_t> tasks{0};
+        std::atomic<uint64_t> steals{0};
+        std::atomic<uint64_t> busyNs{0};
+        std::atomic<uint64_t> idleNs{0};
+        LatencyHistogram queueWait;
+        LatencyHistogram runTime;
+    };
+
+    struct NodeCache {
+        TaskNode* head = nullptr;
+        size_t count = 0;
+        ~NodeCache();
+    };
+
+    // Global queues of one NUMA node (the only node without numaAware)
+    struct alignas(64) NodeQueue {
+        explicit NodeQueue(const ThreadPoolConfig& config);
+        ~NodeQueue();
+
+        pthread_mutex_t mutex;
+        pthread_cond_t  cond;                          // CLOCK_MONOTONIC for idle timeouts
+        PriorityTaskQueue queue;                       // guarded by mutex
+        std::unique_ptr<MpmcRingQueue<QueuedTask>> ring;  // LOCK_FREE_RING only
+
+        // Readable without mutex
+        std::atomic<size_t> size;      // tasks in queue
+        std::atomic<size_t> urgent;    // HIGH or deadline tasks in queue
+        std::atomic<size_t> sleepers;  // workers parked on cond
+    };
+
+    struct Worker {
+        ThreadPool* pool;
+        size_t index;
+        size_t node;            // index into nodes
+        std::vector<int> cpus;  // affinity, empty = not pinned
+        pthread_t thread;
+        bool running;    // slot has a live thread; guarded by workersMutex
+        unsigned rng;    // victim selection state
+        unsigned tick;   // tasks looked up, for periodic global polling
+        WorkStealingDeque<TaskNode> deque;
+        std::unique_ptr<WorkerMetrics> metrics;   // null unless collectMetrics
+        Clock::time_point lastActive;             // end of the previous task
+    };
+
+    template <bool Move, typename F>
+    static Task makeTask(F& fn);
+
+    Worker* localWorker() const;
+    size_t homeNode(const TaskOptions& options) const;
+    void pushGlobal(Task&& task, const TaskOptions& options);
+    void wakeLocked(NodeQueue& node, size_t count);
+    void wakeWorkers(size_t home, size_t count);
+
+    int startThread(Worker& w);
     static void* workerEntry(void* arg);
-    void workerLoop();
+    void workerLoop(Worker& self);
+    void multiQueueWorkerLoop(Worker& self);
+
+    bool waitForWork(NodeQueue& node);
+    bool tryRetire(Worker& self);
+    size_t idleWorkers() const;
+    void maybeGrow(size_t queued);
+    void maybeGrowAfterWait(PriorityTaskQueue::Clock::time_point enqueued,
+                            PriorityTaskQueue::Clock::time_point now);
+    bool spawnWorker();
+
+    // Submission timestamp for queue-wait metrics, or the epoch when disabled
+    Clock::time_point stamp() const {
+        return config.collectMetrics ? Clock::now() : Clock::time_point();
+    }
+    void runTask(Worker& self, Task& task, Clock::time_point enqueued);
+
+    bool findTask(Worker& self, Task& out, Clock::time_point& enqueued);
+    bool hasVisibleWork(const Worker& self) const;
+    bool spinForWork(const Worker& self) const;
+    bool park(Worker& self);
+
+    bool popGlobal(Worker& self, Task& out, Clock::time_point& enqueued);
+    bool popNode(NodeQueue& node, Task& out, Clock::time_point& enqueued);
+    bool popRing(Worker& self, Task& out, Clock::time_point& enqueued);
+    TaskNode* stealFromPeers(Worker& self);
+    bool peersHaveWork(const Worker& self) const;
 
-    std::vector<pthread_t> workers;
-    std::queue<std::function<void()>> taskQueue;
+    static TaskNode* acquireNode();
+    static void releaseNode(TaskNode* node);
 
-    pthread_mutex_t queueMutex;
-    pthread_cond_t  queueCond;
+    static thread_local Worker* currentWorker;
+    static thread_local NodeCache nodeCache;
 
-    bool stopping;
+    ThreadPoolConfig config;
+    CpuTopology topology;
+    std::vector<std::unique_ptr<NodeQueue>> nodes;
+
+    // One slot per potential worker (maxThreads in elastic mode), allocated
+    // up front so thieves can walk the list without locking.
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<pthread_t> retiredThreads;   // exited, not yet joined; guarded by workersMutex
+
+    mutable pthread_mutex_t workersMutex;    // worker slot bookkeeping
+    pthread_mutex_t spawnMutex;      // serializes thread creation against shutdown()
+
+    std::atomic<bool> stopping;
+    std::atomic<size_t> liveWorkers;
+    std::atomic<size_t> slotsInUse;   // high-water mark of worker slots
+    std::atomic<bool> spawnInFlight;  // a new worker has not started yet
+    Clock::time_point startTime;
 };
 
+template <typename F, typename... Args>
+auto ThreadPool::submit(F&& f, Args&&... args)
+    -> std::future<std::invoke_result_t<std::decay_t<F>&, std::decay_t<Args>...>> {
+    return submit(TaskOptions(), std::forward<F>(f), std::forward<Args>(args)...);
+}
+
+template <typename F, typename... Args>
+auto ThreadPool::submit(const TaskOptions& options, F&& f, Args&&... args)
+    -> std::future<std::invoke_result_t<std::decay_t<F>&, std::decay_t<Args>...>> {
+    using R = std::invoke_result_t<std::decay_t<F>&, std::decay_t<Args>...>;
+
+    std::promise<R> promise;
+    std::future<R> future = promise.get_future();
+
+    post(options, [promise = std::move(promise),
+          fn = std::forward<F>(f),
+          bound = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+        try {
+            if constexpr (std::is_void<R>::value) {
+                std::apply(fn, std::move(bound));
+                promise.set_value();
+            } else {
+                promise.set_value(std::apply(fn, std::move(bound)));
+            }
+        } catch (...) {
+            promise.set_exception(std::current_exception());
+        }
+    });
+    return future;
+}
+
+template <bool Move, typename F>
+Task ThreadPool::makeTask(F& fn) {
+    if constexpr (Move) {
+        return Task(std::move(fn));
+    } else {
+        return Task(fn);
+    }
+}
+
+template <typename Range>
+void ThreadPool::submitBatch(Range&& tasks) {
+    constexpr bool movable = !std::is_lvalue_reference<Range>::value;
+    size_t count = 0;
+
+    if (Worker* self = localWorker()) {
+        Clock::time_point enqueued = stamp();
+        for (auto&& fn : tasks) {
+            TaskNode* node = acquireNode();
+            node->task = makeTask<movable>(fn);
+            node->enqueued = enqueued;
+            self->deque.push(node);
+            ++count;
+        }
+        wakeWorkers(self->node, count);
+        maybeGrow(self->deque.size());
+        return;
+    }
+
+    TaskOptions options;
+    size_t home = homeNode(options);
+    NodeQueue& node = *nodes[home];
+
+    if (node.ring) {
+        Clock::time_point enqueued = stamp();
+        for (auto&& fn : tasks) {
+            QueuedTask queued{makeTask<movable>(fn), enqueued};
+            if (node.ring->tryPush(std::move(queued))) {
+                ++count;
+            } else {
+                pushGlobal(std::move(queued.task), options);
+            }
+        }
+        wakeWorkers(home, count);
+        maybeGrow(node.ring->size());
+        return;
+    }
+
+    auto now = PriorityTaskQueue::Clock::now();
+    pthread_mutex_lock(&node.mutex);
+    try {
+        for (auto&& fn : tasks) {
+            node.queue.push(makeTask<movable>(fn), options, now);
+            ++count;
+        }
+    } catch (...) {
+        node.size.store(node.queue.size(), std::memory_order_relaxed);
+        pthread_mutex_unlock(&node.mutex);
+        wakeWorkers(home, count);
+        throw;
+    }
+    size_t queued = node.queue.size();
+    node.size.store(queued, std::memory_order_relaxed);
+    pthread_mutex_unlock(&node.mutex);
+    wakeWorkers(home, count);
+    maybeGrow(queued);
+}
+
+template <typename F>
+void ThreadPool::parallelFor(size_t begin, size_t end, size_t grain, F&& fn) {
+    if (begin >= end) {
+        return;
+    }
+    if (grain == 0) {
+        grain = 1;
+    }
+
+    // Shared with the helper tasks, which may start after the loop is done.
+    struct State {
+        std::atomic<size_t> next;
+        std::atomic<size_t> remaining;
+        size_t end;
+        size_t grain;
+        size_t participants;
+        std::remove_reference_t<F>* fn;
+        bool finished;
+        std::exception_ptr error;
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+
+        State() : finished(false) {
+            pthread_mutex_init(&mutex, nullptr);
+            pthread_cond_init(&cond, nullptr);
+        }
+        ~State() {
+            pthread_mutex_destroy(&mutex);
+            pthread_cond_destroy(&cond);
+        }
+
+        void complete(size_t n) {
+            if (remaining.fetch_sub(n, std::memory_order_acq_rel) == n) {
+                pthread_mutex_lock(&mutex);
+                finished = true;
+                pthread_cond_broadcast(&cond);
+                pthread_mutex_unlock(&mutex);
+            }
+        }
+
+        // Claim and run chunks until the range is exhausted.
+        void run() {
+            size_t cur = next.load(std::memory_order_relaxed);
+            while (cur < end) {
+                size_t left = end - cur;
+                size_t chunk = left / (2 * participants);
+                if (chunk < grain) {
+                    chunk = grain;
+                }
+                if (chunk > left) {
+                    chunk = left;
+                }
+                if (!next.compare_exchange_weak(cur, cur + chunk, std::memory_order_relaxed)) {
+                    continue;
+                }
+                try {
+                    for (size_t i = cur; i < cur + chunk; ++i) {
+                        (*fn)(i);
+                    }
+                } catch (...) {
+                    pthread_mutex_lock(&mutex);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                    pthread_mutex_unlock(&mutex);
+                    // Abandon whatever nobody has claimed yet
+                    size_t old = next.exchange(end, std::memory_order_relaxed);
+                    if (old < end) {
+                        complete(end - old);
+                    }
+                }
+                complete(chunk);
+                cur = next.load(std::memory_order_relaxed);
+            }
+        }
+    };
+
+    size_t chunks = (end - begin + grain - 1) / grain;
+    size_t live = size();
+    size_t helpers = live < chunks ? live : chunks - 1;
+
+    auto state = std::make_shared<State>();
+    state->next.store(begin, std::memory_order_relaxed);
+    state->remaining.store(end - begin, std::memory_order_relaxed);
+    state->end = end;
+    state->grain = grain;
+    state->participants = helpers + 1;
+    state->fn = &fn;
+
+    if (helpers > 0) {
+        std::vector<Task> batch;
+        batch.reserve(helpers);
+        for (size_t i = 0; i < helpers; ++i) {
+            batch.emplace_back([state]() { state->run(); });
+        }
+        submitBatch(std::move(batch));
+    }
+
+    state->run();
+
+    pthread_mutex_lock(&state->mutex);
+    while (!state->finished) {
+        pthread_cond_wait(&state->cond, &state->mutex);
+    }
+    std::exception_ptr error = state->error;
+    pthread_mutex_unlock(&state->mutex);
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
 #endif
\ No newline at end of file
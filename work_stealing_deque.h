@@ -0,0 +1,153 @@
+#ifndef WORK_STEALING_DEQUE_H
+#define WORK_STEALING_DEQUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * WorkStealingDeque:
+ * Chase-Lev deque of T* (weak memory model version from Le et al.,
+ * "Correct and Efficient Work-Stealing for Weak Memory Models").
+ *
+ *   - push() / pop(): owner thread only, works on the bottom end (LIFO)
+ *   - steal():        any thread, takes from the top end (FIFO)
+ *
+ * The deque does not own the pointed-to items. The buffer grows when full;
+ * old buffers are kept until destruction because a thief may still be
+ * reading from them.
+ */
+template <typename T>
+class WorkStealingDeque {
+public:
+    explicit WorkStealingDeque(size_t capacity = 256)
+        : top(0), bottom(0), buffer(new Buffer(roundUp(capacity))) {}
+
+    ~WorkStealingDeque() {
+        delete buffer.load(std::memory_order_relaxed);
+        for (Buffer* b : retired) {
+            delete b;
+        }
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    // Owner only: push an item onto the bottom.
+    void push(T* item) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        Buffer* buf = buffer.load(std::memory_order_relaxed);
+
+        if (b - t > static_cast<int64_t>(buf->mask)) {
+            buf = grow(buf, b, t);
+        }
+        buf->put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // Owner only: pop the most recently pushed item, nullptr if empty.
+    T* pop() {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Buffer* buf = buffer.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            // Empty
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        T* item = buf->get(b);
+        if (t == b) {
+            // Last item: race against thieves for it
+            if (!top.compare_exchange_strong(t, t + 1,
+                                             std::memory_order_seq_cst,
+                                             std::memory_order_relaxed)) {
+                item = nullptr;
+            }
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    // Any thread: take the oldest item, nullptr if empty or lost a race.
+    T* steal() {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+
+        if (t >= b) {
+            return nullptr;
+        }
+
+        Buffer* buf = buffer.load(std::memory_order_acquire);
+        T* item = buf->get(t);
+        if (!top.compare_exchange_strong(t, t + 1,
+                                         std::memory_order_seq_cst,
+                                         std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return item;
+    }
+
+    // Approximate; exact only when called by the owner with no thieves.
+    bool empty() const {
+        int64_t b = bottom.load(std::memory_order_acquire);
+        int64_t t = top.load(std::memory_order_acquire);
+        return t >= b;
+    }
+
+    // Approximate, same caveat as empty()
+    size_t size() const {
+        int64_t b = bottom.load(std::memory_order_acquire);
+        int64_t t = top.load(std::memory_order_acquire);
+        return b > t ? static_cast<size_t>(b - t) : 0;
+    }
+
+private:
+    struct Buffer {
+        explicit Buffer(size_t cap) : mask(cap - 1), slots(new std::atomic<T*>[cap]) {}
+        ~Buffer() { delete[] slots; }
+
+        T* get(int64_t i) const {
+            return slots[static_cast<size_t>(i) & mask].load(std::memory_order_relaxed);
+        }
+        void put(int64_t i, T* item) {
+            slots[static_cast<size_t>(i) & mask].store(item, std::memory_order_relaxed);
+        }
+
+        size_t mask;
+        std::atomic<T*>* slots;
+    };
+
+    static size_t roundUp(size_t n) {
+        size_t cap = 2;
+        while (cap < n) {
+            cap <<= 1;
+        }
+        return cap;
+    }
+
+    Buffer* grow(Buffer* old, int64_t b, int64_t t) {
+        Buffer* bigger = new Buffer((old->mask + 1) * 2);
+        for (int64_t i = t; i < b; ++i) {
+            bigger->put(i, old->get(i));
+        }
+        retired.push_back(old);
+        buffer.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+    // Thieves hammer 'top', the owner hammers 'bottom'; keep them apart.
+    alignas(64) std::atomic<int64_t> top;
+    alignas(64) std::atomic<int64_t> bottom;
+    std::atomic<Buffer*> buffer;
+    std::vector<Buffer*> retired;   // owner only
+};
+
+#endif